@@ -0,0 +1,167 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <semaphore.h>
+
+#include "semaphore.hpp"
+
+/**
+ * Contention benchmark of the futex based Semaphore against the previous
+ * implementation on a heap allocated sem_t.
+ *
+ * "contended" lets every thread take and return one of threads / 2 permits in a
+ * loop, so half of the threads wait at any time. "ping-pong" hands one permit
+ * back and forth between pairs of threads, which is the wake up path of a
+ * worker that waits for a task.
+ *
+ * Usage: semaphore_bench.run [maxThreads] [operations]
+ */
+
+/**
+ * @brief The previous Semaphore, a heap allocated sem_t with a check for use
+ * after move on every operation.
+ */
+class PosixSemaphore
+{
+private:
+
+    sem_t *_semaphore;
+
+public:
+
+    PosixSemaphore(int initialValue = 0)
+    {
+        _semaphore = new sem_t;
+        sem_init(_semaphore, 0, initialValue);
+    }
+
+    PosixSemaphore(const PosixSemaphore &other) = delete;
+
+    PosixSemaphore & operator=(const PosixSemaphore &other) = delete;
+
+    ~PosixSemaphore()
+    {
+        sem_destroy(_semaphore);
+        delete _semaphore;
+    }
+
+    void post()
+    {
+        if (_semaphore == nullptr)
+            throw std::runtime_error("Semaphore used after move");
+
+        sem_post(_semaphore);
+    }
+
+    void wait()
+    {
+        if (_semaphore == nullptr)
+            throw std::runtime_error("Semaphore used after move");
+
+        sem_wait(_semaphore);
+    }
+};
+
+/**
+ * @brief Run fn(threadIndex) on the given number of threads at once.
+ *
+ * @return The operations per second of all threads together.
+ */
+template <typename Fn>
+static double runThreads(int threads, int64_t operations, Fn &&fn)
+{
+    std::atomic<bool> go{false};
+    std::vector<std::thread> workers;
+
+    for (int t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&go, &fn, t]() {
+            while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+            fn(t);
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+
+    for (auto &worker : workers)
+        worker.join();
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return operations / elapsed.count();
+}
+
+template <typename Sem>
+static double benchContended(int threads, int64_t operations)
+{
+    Sem sem(std::max(1, threads / 2));
+
+    int64_t perThread = operations / threads;
+
+    return runThreads(threads, perThread * threads, [&sem, perThread](int) {
+        for (int64_t i = 0; i < perThread; i++)
+        {
+            sem.wait();
+            sem.post();
+        }
+    });
+}
+
+template <typename Sem>
+static double benchPingPong(int threads, int64_t operations)
+{
+    int pairs = std::max(1, threads / 2);
+
+    // Every pair has a semaphore for each direction
+    std::vector<Sem> sems(pairs * 2);
+
+    int64_t perPair = operations / pairs;
+
+    return runThreads(pairs * 2, perPair * pairs, [&sems, perPair](int t) {
+        Sem &mine = sems[t];
+        Sem &other = sems[t ^ 1];
+
+        for (int64_t i = 0; i < perPair / 2; i++)
+        {
+            if (t % 2 == 0)
+            {
+                other.post();
+                mine.wait();
+            }
+            else
+            {
+                mine.wait();
+                other.post();
+            }
+        }
+    });
+}
+
+int main(int argc, char **argv)
+{
+    int maxThreads = argc > 1 ? std::atoi(argv[1]) : 64;
+    int64_t operations = argc > 2 ? std::atoll(argv[2]) : 400000;
+
+    std::printf("%d hardware threads, %lld operations per run, operations/s\n\n",
+        (int)std::thread::hardware_concurrency(), (long long)operations);
+    std::printf("%8s %16s %16s %16s %16s\n", "threads", "contended futex", "contended sem_t",
+        "ping-pong futex", "ping-pong sem_t");
+
+    for (int threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        std::printf("%8d %16.0f %16.0f %16.0f %16.0f\n", threads,
+            benchContended<Semaphore>(threads, operations),
+            benchContended<PosixSemaphore>(threads, operations),
+            benchPingPong<Semaphore>(threads, operations),
+            benchPingPong<PosixSemaphore>(threads, operations));
+    }
+
+    return 0;
+}
@@ -0,0 +1,146 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#include "threadpool.hpp"
+
+/**
+ * Throughput of the fifo and the work stealing scheduling of Threadpool, for 1
+ * to 64 worker threads.
+ *
+ * "submit" adds all tasks from the main thread, which is the pattern of the
+ * accept loop. "spawn" starts one task that recursively spawns a binary tree of
+ * tasks from inside the workers, which is the pattern of parallel algorithms.
+ *
+ * Usage: threadpool_bench.run [maxThreads] [tasks]
+ */
+
+/**
+ * @brief A bit of work per task, so the tasks are not only queue overhead.
+ */
+static const int TASK_WORK = 200;
+
+static void doWork()
+{
+    static thread_local uint32_t x = 1;
+
+    for (int i = 0; i < TASK_WORK; i++)
+    {
+        x = x * 1664525u + 1013904223u;
+    }
+
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+}
+
+/**
+ * @brief Counts the finished tasks and signals when all are done.
+ */
+struct Completion
+{
+    std::atomic<int64_t> remaining;
+    TaskSignal done;
+
+    explicit Completion(int64_t tasks) : remaining{tasks} { }
+
+    void finishOne()
+    {
+        if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            done.set();
+    }
+
+    void wait()
+    {
+        while (!done.isSet())
+            done.wait();
+    }
+};
+
+static double benchSubmit(Threadpool &pool, int64_t tasks)
+{
+    Completion completion(tasks);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int64_t i = 0; i < tasks; i++)
+    {
+        pool.addTask([&completion]() {
+            doWork();
+            completion.finishOne();
+        });
+    }
+
+    completion.wait();
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return tasks / elapsed.count();
+}
+
+static void spawnTree(Threadpool &pool, Completion &completion, int depth)
+{
+    doWork();
+
+    if (depth > 0)
+    {
+        for (int child = 0; child < 2; child++)
+        {
+            pool.addTask([&pool, &completion, depth]() {
+                spawnTree(pool, completion, depth - 1);
+            });
+        }
+    }
+
+    completion.finishOne();
+}
+
+static double benchSpawn(Threadpool &pool, int64_t tasks)
+{
+    // A full binary tree of the given depth has 2^(depth+1) - 1 tasks
+    int depth = 0;
+    while (((int64_t)2 << (depth + 1)) - 1 <= tasks) depth++;
+
+    int64_t treeTasks = ((int64_t)2 << depth) - 1;
+
+    Completion completion(treeTasks);
+
+    auto start = std::chrono::steady_clock::now();
+
+    pool.addTask([&pool, &completion, depth]() {
+        spawnTree(pool, completion, depth);
+    });
+
+    completion.wait();
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return treeTasks / elapsed.count();
+}
+
+int main(int argc, char **argv)
+{
+    int maxThreads = argc > 1 ? std::atoi(argv[1]) : 64;
+    int64_t tasks = argc > 2 ? std::atoll(argv[2]) : 200000;
+
+    std::printf("%d hardware threads, %lld tasks per run, tasks/s\n\n",
+        (int)std::thread::hardware_concurrency(), (long long)tasks);
+    std::printf("%8s %14s %14s %14s %14s\n", "threads", "submit fifo", "submit steal", "spawn fifo", "spawn steal");
+
+    for (int threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        double results[4];
+        int column = 0;
+
+        for (auto bench : {&benchSubmit, &benchSpawn})
+        {
+            for (auto scheduling : {Threadpool::Scheduling::Fifo, Threadpool::Scheduling::WorkStealing})
+            {
+                Threadpool pool(threads, Threadpool::DISABLE_MAX_QUEUE_BACKLOG, scheduling);
+                results[column++] = bench(pool, tasks);
+            }
+        }
+
+        std::printf("%8d %14.0f %14.0f %14.0f %14.0f\n", threads, results[0], results[1], results[2], results[3]);
+    }
+
+    return 0;
+}
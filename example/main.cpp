@@ -11,8 +11,12 @@
 #include <netinet/in.h>
 #include <unistd.h>
 
+#include "buffer_pool.hpp"
 #include "httpd.hpp"
 #include "http_service.hpp"
+#include "http_directory.hpp"
+#include "http_static_route.hpp"
+#include "response_cache.hpp"
 
 
 HttpRouteHandling handle_echo_path(const HttpRequest &req, HttpResponse &res)
@@ -26,6 +30,21 @@ HttpRouteHandling handle_echo_path(const HttpRequest &req, HttpResponse &res)
     return HttpRouteHandling::End;
 }
 
+// Query string and cookie example: /greet?name=World
+HttpRouteHandling handle_greet(const HttpRequest &req, HttpResponse &res)
+{
+    std::string_view name = req.query("name");
+
+    std::string resp = "Hello " + std::string(name.empty() ? "stranger" : name);
+
+    std::string_view visits = req.cookie("visits");
+    if (!visits.empty()) resp += ", visit number " + std::string(visits);
+
+    res.send((uint8_t*) resp.c_str(), resp.size());
+
+    return HttpRouteHandling::End;
+}
+
 // Calculate the first N prime numbers where N is extracted from the request uri
 HttpRouteHandling handle_prime(const HttpRequest &req, HttpResponse &res)
 {
@@ -59,25 +78,89 @@ HttpRouteHandling handle_prime(const HttpRequest &req, HttpResponse &res)
     return HttpRouteHandling::End;
 }
 
+HttpRouteHandling handle_ping(const HttpRequest &req, HttpResponse &res)
+{
+    char body[] = "pong";
+
+    res.sendAll((uint8_t*)body, sizeof(body) - 1);
+
+    return HttpRouteHandling::End;
+}
+
+HttpRouteHandling handle_version(const HttpRequest &req, HttpResponse &res)
+{
+    char body[] = "cpp-httpd example";
+
+    res.sendAll((uint8_t*)body, sizeof(body) - 1);
+
+    return HttpRouteHandling::End;
+}
+
+// Coroutine handler that waits without holding a thread. The response is sent 
+// after N milliseconds, where N is extracted from the request uri
+HttpTask handle_delay(HttpRequest &req, HttpResponse &res)
+{
+    int delay = std::stoi(req.regexMatches().at(1));
+
+    co_await sleepFor(std::chrono::milliseconds(delay));
+
+    std::string body = "Waited " + std::to_string(delay) + "ms";
+
+    co_await res.write((uint8_t*) body.c_str(), body.size());
+
+    co_return HttpRouteHandling::End;
+}
+
+// Coroutine handler that reads the request body and responds with its size. The
+// buffer comes from the BufferPool, a local array would make the coroutine frame 
+// too large for the FramePool
+HttpTask handle_upload(HttpRequest &req, HttpResponse &res)
+{
+    BufferPool::Buffer buff = BufferPool::acquire();
+    size_t total = 0;
+
+    while (size_t n = co_await req.body().read(buff.data(), buff.size()))
+    {
+        total += n;
+    }
+
+    std::string body = "Received " + std::to_string(total) + " bytes";
+
+    co_await res.write((uint8_t*) body.c_str(), body.size());
+
+    co_return HttpRouteHandling::End;
+}
+
+// Literal routes that are fixed at compile time. The dispatch is generated
+// by the compiler and the handlers are called directly
+constexpr StaticRouteTable staticRoutes {
+    StaticRoute<&handle_ping>{"/ping"},
+    StaticRoute<&handle_version>{"/version"}
+};
+
 int main(int argc, char **argv)
 {
     // Create the webserver on port 8081. By default listening on 0.0.0.0
     HttpServer srv(8081);
 
-    // Log Middleware example
-    srv.addRoute(HttpRoute(
-        "",
-        [](const HttpRequest &req, HttpResponse &res) {
-
-            std::string log = "Request: " + req.ip() + " => " + req.uri() + "\n";
-            log +=            "  Agent: " + req.headers().getHeader(HttpHeader::UserAgent).getValue() + "\n";
+    // Access log example. Requests are logged to stdout by a background thread
+    srv.setAccessLog(std::make_shared<AccessLog>(STDOUT_FILENO));
 
-            std::cout << log;
-            
+    // Middleware example. The before hook runs ahead of the route matching and the
+    // after hook can inspect the finished response
+    srv.addMiddleware(HttpMiddleware{
+        [](const HttpRequest &req, HttpResponse &res) {
+            res.getHeadersWritable().setHeader(HeaderId::Server, "cpp-httpd");
             return HttpRouteHandling::Continue;
         },
-        HttpRoute::MatchType::MatchAny
-    ));
+        [](const HttpRequest &req, const HttpResponse &res, std::chrono::microseconds latency) {
+            if (latency > std::chrono::milliseconds(100))
+            {
+                std::cerr << "Slow request: " + req.uri() + " took " 
+                    + std::to_string(latency.count()) + "us\n";
+            }
+        }
+    });
 
     // Example index route with hardcoded html response
     srv.addRoute(HttpRoute(
@@ -104,6 +187,9 @@ int main(int argc, char **argv)
         }
     ));
 
+    // Compile-time route table example
+    srv.addRoute(staticRoutes.asRoute());
+
     // Static file example
     srv.addRoute(serveFile(
         "/example.html",
@@ -111,17 +197,76 @@ int main(int argc, char **argv)
         "text/html; charset=utf-8"
     ));
 
-    // Cached static file example. The file is loaded into memory at launch
+    // Cached static file example. The file is mapped (or read, if it is small) on the
+    // first request and reloaded when it changes
     srv.addRoute(serveFileCached(
         "/cached/example.html",
         "./static/example.html",
         "text/html; charset=utf-8"
     ));
 
-    // Example for a handler function that uses regex to extract a path segment
+    // Directory example. Serves all files below ./static, small files are mapped
+    // into memory on first access
+    srv.addRoute(serveDirectory("/static", "./static", DirectoryOptions{.mapFiles = true}));
+
+    // Example for a cpu heavy handler that runs on its own executor. At most 2 
+    // requests are calculated at the same time and 16 can wait, further requests 
+    // are rejected with 503 while the other routes stay responsive. The results 
+    // are cached for a second, and served stale for 10 more while one request 
+    // calculates them again. Concurrent requests for the same uncached N wait for
+    // a single calculation
+    auto primeExecutor = std::make_shared<HttpExecutor>(2, 16);
+
+    srv.addRoute(cacheResponses(
+        coalesceRequests(HttpRoute("/prime/(\\d+)", &handle_prime).setExecutor(primeExecutor)),
+        ResponseCacheOptions{.staleWhileRevalidate = std::chrono::seconds(10)}
+    ));
+
+    // Example for splitting one cpu heavy request across all cores. The primes 
+    // below N are counted in parallel chunks on a dedicated compute pool
+    Threadpool computePool(Threadpool::AUTO_NO_WORKERS, Threadpool::DISABLE_MAX_QUEUE_BACKLOG, 
+        Threadpool::Scheduling::WorkStealing);
+
+    srv.addRoute(HttpRoute(
+        "/primecount/(\\d+)",
+        [&computePool](const HttpRequest &req, HttpResponse &res) {
+            size_t max = std::stoul(req.regexMatches().at(1));
+
+            size_t count = computePool.parallelReduce(2, max, 1000, (size_t)0,
+                [](size_t num) -> size_t {
+                    for (size_t i = 2; i * i <= num; i++)
+                    {
+                        if (num % i == 0) return 0;
+                    }
+                    return 1;
+                },
+                [](size_t a, size_t b) { return a + b; }
+            );
+
+            std::string result = std::to_string(count) + " primes below " + std::to_string(max);
+
+            res.send((uint8_t*) result.c_str(), result.size());
+
+            return HttpRouteHandling::End;
+        }
+    ));
+
+    // Coroutine handler examples
+    srv.addRoute(HttpRoute(
+        "/delay/(\\d+)",
+        &handle_delay
+    ));
+
+    srv.addRoute(HttpRoute(
+        "/upload",
+        &handle_upload,
+        HttpRoute::MatchType::Literal
+    ));
+
     srv.addRoute(HttpRoute(
-        "/prime/(\\d+)",
-        &handle_prime
+        "/greet",
+        &handle_greet,
+        HttpRoute::MatchType::Literal
     ));
 
     // Example for a handler function that uses regex to extract a path segment
@@ -0,0 +1,244 @@
+#ifndef _ACCESS_LOG_HPP
+#define _ACCESS_LOG_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+/**
+ * @brief A compact, fixed size record of a single handled request. Strings are
+ * truncated to fit into the record, so no allocations are needed for logging.
+ */
+struct AccessLogRecord
+{
+    /**
+     * @brief Time the request was received in microseconds since the unix epoch.
+     */
+    int64_t timestampUs;
+
+    /**
+     * @brief Time it took to handle the request in microseconds.
+     */
+    uint32_t latencyUs;
+
+    /**
+     * @brief HTTP status code of the response.
+     */
+    uint16_t status;
+
+    /**
+     * @brief Remote port of the connection.
+     */
+    uint16_t port;
+
+    /**
+     * @brief Number of bytes written to the connection (head and body).
+     */
+    uint64_t bytesSent;
+
+    char ip[16];
+
+    char method[8];
+
+    char uri[96];
+
+    /**
+     * @brief Copy a string into one of the fixed size char arrays of the record,
+     * truncating it if needed. The result is always null terminated.
+     */
+    template <size_t N>
+    static void copyField(char (&field)[N], const std::string &value)
+    {
+        size_t len = value.size() < N - 1 ? value.size() : N - 1;
+        value.copy(field, len);
+        field[len] = '\0';
+    }
+};
+
+/**
+ * @brief An asynchronous access log that never blocks the request path.
+ *
+ * Every thread that logs gets its own single-producer single-consumer ring buffer
+ * of AccessLogRecords, so logging is a few plain stores and one atomic store
+ * without any shared lock. A background thread collects the records from all
+ * buffers, formats them and writes them to the output file descriptor in large
+ * batches.
+ *
+ * If a ring buffer is full because the writer can't keep up, the record is
+ * dropped and counted instead of waiting. The number of dropped records is
+ * reported in the log output and can be queried with getDroppedRecords().
+ */
+class AccessLog
+{
+private:
+
+    /**
+     * @brief Bounded single-producer single-consumer ring buffer. The producer is
+     * the thread that owns the buffer and the consumer is the writer thread.
+     */
+    struct RecordBuffer
+    {
+        /**
+         * @brief Position of the next record to write. Only written by the producer.
+         */
+        alignas(64) std::atomic<size_t> head{0};
+
+        /**
+         * @brief Position of the next record to read. Only written by the consumer.
+         */
+        alignas(64) std::atomic<size_t> tail{0};
+
+        /**
+         * @brief Number of records that were dropped because the buffer was full.
+         */
+        alignas(64) std::atomic<uint64_t> dropped{0};
+
+        /**
+         * @brief Indicates that a thread currently uses this buffer as its producer.
+         */
+        std::atomic<bool> claimed{false};
+
+        std::thread::id owner;
+
+        std::vector<AccessLogRecord> records;
+
+        RecordBuffer(size_t capacity);
+
+        bool tryPush(const AccessLogRecord &record);
+
+        bool tryPop(AccessLogRecord &record);
+    };
+
+    struct LocalBufferCache;
+
+    /**
+     * @brief Used to tell the thread local buffer caches of different AccessLog
+     * instances apart.
+     */
+    static std::atomic<uint64_t> nextLogId;
+
+    const uint64_t logId;
+
+    /**
+     * @brief File descriptor that the formatted log lines are written to.
+     */
+    int fd;
+
+    /**
+     * @brief Capacity of each per thread ring buffer. This is always a power of two.
+     */
+    size_t bufferCapacity;
+
+    /**
+     * @brief Time the writer thread sleeps when there were no new records.
+     */
+    std::chrono::milliseconds flushInterval;
+
+    /**
+     * @brief All ring buffers that were created for producer threads.
+     *
+     * NOTE: Access must be synchronized with the mtxBuffers mutex. This is only
+     * needed when a thread logs for the first time and by the writer thread.
+     */
+    std::vector<std::shared_ptr<RecordBuffer>> buffers;
+
+    std::mutex mtxBuffers;
+
+    /**
+     * @brief A copy of buffers that the writer thread drains without holding 
+     * mtxBuffers, so threads that log for the first time never wait for a 
+     * write. Only used by the writer thread.
+     */
+    std::vector<std::shared_ptr<RecordBuffer>> drainBuffers;
+
+    /**
+     * @brief Total number of records that were reported as dropped so far.
+     */
+    uint64_t reportedDropped = 0;
+
+    bool stopRequested = false;
+
+    std::mutex mtxStop;
+
+    std::condition_variable cvStop;
+
+    std::thread writerThread;
+
+    /**
+     * @brief Get the ring buffer of the calling thread, creating or claiming one
+     * if the thread doesn't have one yet.
+     */
+    RecordBuffer & localBuffer();
+
+    /**
+     * @brief Drain all ring buffers, format the records into the batch and write
+     * it out.
+     *
+     * @return The number of records that were written.
+     */
+    size_t flush(std::string &batch);
+
+    /**
+     * @brief Format a single record in a common log format like style.
+     */
+    static void formatRecord(const AccessLogRecord &record, std::string &out);
+
+    /**
+     * @brief Write the whole string to fd, retrying on partial writes.
+     */
+    void writeAll(const std::string &data);
+
+    /**
+     * @brief Internal function of the background writer thread.
+     */
+    void writeLoop();
+
+public:
+
+    /**
+     * @brief Create the access log and start the background writer thread.
+     *
+     * @param fd The file descriptor to write the log to. The descriptor is not
+     *  closed by the AccessLog.
+     *
+     * @param bufferCapacity The number of records each logging thread can buffer
+     *  before records are dropped. Rounded up to the next power of two.
+     *
+     * @param flushInterval The time the writer waits for new records when the
+     *  buffers are empty.
+     */
+    AccessLog(int fd = STDOUT_FILENO, size_t bufferCapacity = 4096,
+        std::chrono::milliseconds flushInterval = std::chrono::milliseconds(100));
+
+    AccessLog(const AccessLog &other) = delete;
+
+    AccessLog & operator=(const AccessLog &other) = delete;
+
+    /**
+     * @brief Stops the writer thread after writing out all remaining records.
+     */
+    ~AccessLog();
+
+    /**
+     * @brief Add a record to the log. This never blocks. If the buffer of the
+     * calling thread is full, the record is dropped and counted.
+     */
+    void log(const AccessLogRecord &record);
+
+    /**
+     * @brief Get the total number of records that were dropped because a buffer
+     * was full.
+     */
+    uint64_t getDroppedRecords();
+
+};
+
+#endif // _ACCESS_LOG_HPP
@@ -0,0 +1,234 @@
+#ifndef _ASYNC_IO_HPP
+#define _ASYNC_IO_HPP
+
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+
+#include <sys/types.h>
+
+#include "io_loop.hpp"
+
+/**
+ * @brief Awaitable that writes the data to a socket without blocking a thread.
+ *
+ * As much as possible is written right away. If the socket buffer is full, the
+ * coroutine is suspended until the IoLoop reports the socket as writable again.
+ * Throws HttpException::TcpSend on errors.
+ */
+class AsyncWrite : public IoWaiter
+{
+private:
+
+    int sockfd;
+
+    /**
+     * @brief Data that is written before the actual data, e.g. the response head.
+     */
+    std::pmr::string prefix;
+
+    const uint8_t *data;
+
+    size_t dataLength;
+
+    /**
+     * @brief The number of bytes of prefix and data written so far.
+     */
+    size_t written = 0;
+
+    size_t *bytesSent;
+
+    bool failed = false;
+
+    std::coroutine_handle<> handle;
+
+    /**
+     * @brief Write until everything was written or the socket would block.
+     * 
+     * @return True if the write is finished (successfully or not).
+     */
+    bool tryWrite();
+
+public:
+
+    /**
+     * @param bytesSent Counter that is increased by the number of bytes written, 
+     *  or nullptr.
+     */
+    AsyncWrite(int sockfd, std::pmr::string prefix, const uint8_t *data, size_t dataLength, 
+        size_t *bytesSent = nullptr);
+
+    bool await_ready();
+
+    void await_suspend(std::coroutine_handle<> h);
+
+    void await_resume();
+
+    void onReady() override;
+
+};
+
+/**
+ * @brief Awaitable that reads from a socket without blocking a thread.
+ *
+ * Data that was already buffered is returned right away. Otherwise the coroutine
+ * is suspended until the IoLoop reports the socket as readable.
+ */
+class AsyncRead : public IoWaiter
+{
+private:
+
+    int sockfd;
+
+    uint8_t *buffer;
+
+    size_t bufferLength;
+
+    /**
+     * @brief The number of bytes that were read, or -1 on errors.
+     */
+    ssize_t bytesRead = 0;
+
+    size_t *remaining;
+
+    std::coroutine_handle<> handle;
+
+    /**
+     * @return True if the read is finished (successfully or not).
+     */
+    bool tryRead();
+
+public:
+
+    /**
+     * @param remaining The number of bytes that may still be read from the socket. 
+     *  At most this many bytes are read and the value is decreased accordingly.
+     */
+    AsyncRead(int sockfd, uint8_t *buffer, size_t bufferLength, size_t *remaining);
+
+    /**
+     * @brief Create a read that is already finished, e.g. because the data was 
+     * served from a buffer.
+     */
+    explicit AsyncRead(size_t bytesRead);
+
+    bool await_ready();
+
+    void await_suspend(std::coroutine_handle<> h);
+
+    /**
+     * @return The number of bytes read. 0 if there is nothing left to read.
+     */
+    size_t await_resume();
+
+    void onReady() override;
+
+};
+
+/**
+ * @brief Awaitable that reads from a file without blocking the calling thread on
+ * the disk.
+ *
+ * On a worker, data that is already in the page cache is read right away 
+ * (preadv2 with RWF_NOWAIT). Otherwise, and always on the IoLoop thread, the 
+ * read is done by a small pool of file I/O threads and the coroutine is 
+ * suspended until it has finished. It is resumed on the IoLoop thread. Throws 
+ * HttpException::FileRead on errors.
+ */
+class AsyncFileRead : public IoWaiter
+{
+private:
+
+    int fd;
+
+    uint8_t *buffer;
+
+    size_t bufferLength;
+
+    off_t offset;
+
+    size_t readAhead;
+
+    /**
+     * @brief The number of bytes that were read, or -1 on errors.
+     */
+    ssize_t bytesRead = 0;
+
+    std::coroutine_handle<> handle;
+
+    /**
+     * @return True if the data was in the page cache and has been read.
+     */
+    bool tryReadCached();
+
+public:
+
+    /**
+     * @brief The number of threads that do the reads which would block.
+     */
+    static const int FILE_IO_THREADS = 4;
+
+    /**
+     * @param offset The position in the file to read from. The file position of 
+     *  the descriptor is neither used nor changed.
+     * 
+     * @param readAhead The number of bytes behind the read that the I/O thread 
+     *  advises the kernel to load as well, so the next read of a sequential 
+     *  stream is likely served from the page cache.
+     */
+    AsyncFileRead(int fd, uint8_t *buffer, size_t bufferLength, off_t offset, size_t readAhead = 0);
+
+    bool await_ready();
+
+    void await_suspend(std::coroutine_handle<> h);
+
+    /**
+     * @return The number of bytes read. 0 at the end of the file.
+     */
+    size_t await_resume();
+
+    void onReady() override;
+
+};
+
+/**
+ * @brief Awaitable that suspends the coroutine until the deadline has passed.
+ */
+class AsyncSleep : public IoWaiter
+{
+private:
+
+    std::chrono::steady_clock::time_point deadline;
+
+    std::coroutine_handle<> handle;
+
+public:
+
+    AsyncSleep(std::chrono::steady_clock::time_point deadline);
+
+    bool await_ready();
+
+    void await_suspend(std::coroutine_handle<> h);
+
+    void await_resume() { }
+
+    void onReady() override;
+
+};
+
+/**
+ * @brief Suspend the coroutine for the given duration without blocking a thread.
+ *
+ * Usage: co_await sleepFor(std::chrono::milliseconds(10));
+ */
+template <typename Rep, typename Period>
+AsyncSleep sleepFor(std::chrono::duration<Rep, Period> duration)
+{
+    return AsyncSleep(std::chrono::steady_clock::now() 
+        + std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration));
+}
+
+#endif // _ASYNC_IO_HPP
@@ -0,0 +1,75 @@
+#ifndef _BUFFER_POOL_HPP
+#define _BUFFER_POOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Pool of the buffers that file bodies are streamed through.
+ *
+ * Coroutine frames above FramePool::MAX_POOLED_SIZE are allocated from the heap,
+ * so the chunk buffer of a streaming handler must not be a local variable of the
+ * coroutine. The handler takes a Buffer from the pool instead, which is returned
+ * when the Buffer is destroyed.
+ *
+ * Buffers are usually taken on a worker and returned on the IoLoop thread, so
+ * the free list is shared by all threads. It is bounded, so the memory of a
+ * burst of large responses is released again.
+ */
+class BufferPool
+{
+public:
+
+    /**
+     * @brief The size of every buffer.
+     */
+    static const size_t BUFFER_SIZE = 65536;
+
+    /**
+     * @brief The maximum number of free buffers that are kept.
+     */
+    static const size_t MAX_FREE_BUFFERS = 64;
+
+    /**
+     * @brief A buffer of BUFFER_SIZE bytes that belongs to the caller until it
+     * is destroyed.
+     */
+    class Buffer
+    {
+    private:
+
+        uint8_t *memory;
+
+        explicit Buffer(uint8_t *memory);
+
+        friend class BufferPool;
+
+    public:
+
+        Buffer(Buffer &&other);
+
+        Buffer & operator=(Buffer &&other);
+
+        Buffer(const Buffer &other) = delete;
+
+        Buffer & operator=(const Buffer &other) = delete;
+
+        ~Buffer();
+
+        uint8_t * data() const;
+
+        size_t size() const;
+    };
+
+    /**
+     * @brief Take a free buffer, or allocate a new one if there is none.
+     */
+    static Buffer acquire();
+
+private:
+
+    static void release(uint8_t *memory);
+
+};
+
+#endif // _BUFFER_POOL_HPP
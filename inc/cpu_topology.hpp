@@ -0,0 +1,97 @@
+#ifndef _CPU_TOPOLOGY_HPP
+#define _CPU_TOPOLOGY_HPP
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief Describes the cpus of the machine, which of them are SMT siblings on the
+ * same physical core and which NUMA node they belong to.
+ *
+ * The information is read from /sys/devices/system/cpu and /sys/devices/system/node.
+ * If sysfs is not available, every logical cpu is treated as its own physical core
+ * on node 0.
+ */
+class CpuTopology
+{
+public:
+
+    struct Cpu
+    {
+        /**
+         * @brief The logical cpu number as used by the kernel and sched_setaffinity.
+         */
+        int id;
+
+        /**
+         * @brief The physical core id. Only unique within the same package.
+         */
+        int core;
+
+        /**
+         * @brief The physical package (socket) id.
+         */
+        int package;
+
+        /**
+         * @brief The NUMA node the cpu belongs to.
+         */
+        int node;
+    };
+
+private:
+
+    std::vector<Cpu> cpus;
+
+    std::vector<int> nodes;
+
+    /**
+     * @brief Parse a kernel cpu list like "0-3,8-11" into the single cpu numbers.
+     */
+    static std::vector<int> parseCpuList(const std::string &list);
+
+    /**
+     * @brief Read a single integer value from a sysfs file.
+     *
+     * @return The value or fallback if the file can't be read.
+     */
+    static int readInt(const std::string &path, int fallback);
+
+public:
+
+    /**
+     * @brief Read the topology of the machine from sysfs.
+     */
+    static CpuTopology discover();
+
+    /**
+     * @brief All online logical cpus.
+     */
+    const std::vector<Cpu> & getCpus() const;
+
+    /**
+     * @brief The ids of all NUMA nodes that have online cpus.
+     */
+    const std::vector<int> & getNodes() const;
+
+    /**
+     * @brief The logical cpus of the node, including SMT siblings.
+     */
+    std::vector<int> getCpusOfNode(int node) const;
+
+    /**
+     * @brief One logical cpu for every physical core, so that pinning one thread
+     * to each of them never puts two threads on SMT siblings.
+     *
+     * @param node Only return the cores of this NUMA node, or all if -1.
+     */
+    std::vector<int> getPhysicalCores(int node = -1) const;
+
+    /**
+     * @brief The NUMA node of the logical cpu, or 0 if the cpu is unknown.
+     */
+    int getNodeOfCpu(int cpu) const;
+
+};
+
+#endif // _CPU_TOPOLOGY_HPP
@@ -0,0 +1,100 @@
+#ifndef _EVENT_COUNT_HPP
+#define _EVENT_COUNT_HPP
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @brief A futex based event count that allows threads to sleep until a condition
+ * that is checked without locks (e.g. "a queue is not empty") might have changed.
+ *
+ * Waiting is a two step process to avoid lost wakeups:
+ *
+ * @code
+ * while (!queue.tryPop(item))
+ * {
+ *     auto key = ev.prepareWait();
+ *     if (queue.tryPop(item)) { ev.cancelWait(); break; }
+ *     ev.wait(key);
+ * }
+ * @endcode
+ *
+ * The notifying side changes the condition first and then calls notifyOne() or
+ * notifyAll(). Notifying is a single atomic load if there are no waiters, so no
+ * syscall and no lock is needed on the fast path.
+ */
+class EventCount
+{
+private:
+
+    /**
+     * @brief Incremented on every notification that has waiters. This is the
+     * futex word the waiters sleep on.
+     */
+    alignas(64) std::atomic<uint32_t> epoch{0};
+
+    /**
+     * @brief The number of threads between prepareWait() and the end of wait()
+     * or cancelWait().
+     */
+    std::atomic<uint32_t> waiters{0};
+
+public:
+
+    EventCount() = default;
+
+    EventCount(const EventCount &other) = delete;
+
+    EventCount & operator=(const EventCount &other) = delete;
+
+    /**
+     * @brief Announce that the calling thread is about to wait. The condition must
+     * be checked again after this call and before calling wait().
+     *
+     * @return The key that must be passed to wait().
+     */
+    uint32_t prepareWait();
+
+    /**
+     * @brief Abort a wait that was prepared with prepareWait(), because the
+     * condition became true in the meantime.
+     */
+    void cancelWait();
+
+    /**
+     * @brief Sleep until a notification happened after the call to prepareWait()
+     * that returned the key.
+     *
+     * @param key The key returned by prepareWait().
+     */
+    void wait(uint32_t key);
+
+    /**
+     * @brief Same as wait() but only sleeps for a limited time.
+     *
+     * @param key The key returned by prepareWait().
+     *
+     * @param ms The maximum time to wait in milliseconds.
+     *
+     * @return True if a notification happened, false if the time ran out.
+     */
+    bool timedWait(uint32_t key, long ms);
+
+    /**
+     * @brief Wake up one waiting thread, if there are any.
+     */
+    void notifyOne();
+
+    /**
+     * @brief Wake up up to the given number of waiting threads.
+     */
+    void notifyMany(int count);
+
+    /**
+     * @brief Wake up all waiting threads.
+     */
+    void notifyAll();
+
+};
+
+#endif // _EVENT_COUNT_HPP
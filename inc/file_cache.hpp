@@ -0,0 +1,199 @@
+#ifndef _FILE_CACHE_HPP
+#define _FILE_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "mapped_file.hpp"
+
+/**
+ * @brief The immutable content of a cached file, either copied into the heap or
+ * mapped from the page cache.
+ *
+ * Responses hold a shared_ptr to the content while they send it, so evicting or
+ * replacing the cache entry never affects a response that is in flight.
+ */
+class CachedFile
+{
+private:
+
+    std::vector<uint8_t> content;
+
+    std::shared_ptr<const MappedFile> mapping;
+
+    std::string type;
+
+    std::string tag;
+
+public:
+
+    CachedFile(std::vector<uint8_t> &&content, std::string_view contentType, std::string_view etag);
+
+    CachedFile(std::shared_ptr<const MappedFile> mapping, std::string_view contentType, std::string_view etag);
+
+    /**
+     * @brief Smaller files are always copied into the heap, also if mapping is 
+     * requested. They gain little from a mapping, and a copy can't be changed by
+     * rewriting the file.
+     */
+    static const size_t MIN_MAPPED_SIZE = 64 * 1024;
+
+    /**
+     * @brief Load an open regular file, either by reading it into the heap or by
+     * mapping it. The descriptor is not closed.
+     * 
+     * @return The content or nullptr if the file couldn't be read.
+     */
+    static std::shared_ptr<const CachedFile> load(int fd, const struct stat &st, 
+        std::string_view contentType, bool map);
+
+    /**
+     * @brief Same as load() with a descriptor, but opens the file at path.
+     * 
+     * @return The content or nullptr if the path isn't a readable regular file.
+     */
+    static std::shared_ptr<const CachedFile> load(const std::string &path, 
+        std::string_view contentType, bool map);
+
+    /**
+     * @brief Build a strong ETag from the modification time and the size of a file.
+     */
+    static std::string makeETag(const struct stat &st);
+
+    const uint8_t * data() const;
+
+    size_t size() const;
+
+    /**
+     * @brief Check that a mapped file wasn't changed in place since it was 
+     * loaded (see MappedFile::isUnchanged()). Copies are never changed.
+     */
+    bool isUnchanged() const;
+
+    const std::string & contentType() const;
+
+    const std::string & etag() const;
+
+    /**
+     * @brief Check the value of an If-None-Match header against an ETag, so the 
+     * response can be a 304 Not Modified.
+     */
+    static bool matchesETag(std::string_view ifNoneMatch, std::string_view etag);
+
+};
+
+/**
+ * @brief A byte budgeted in-memory cache for file contents, keyed by path.
+ *
+ * The cache is split into NUMBER_OF_SHARDS shards by the hash of the path, each
+ * with its own lock and an equal part of the byte budget, so workers serving 
+ * different files rarely contend. Within a shard the least recently used files 
+ * are evicted until a new file fits (size aware LRU).
+ *
+ * Files above the maximum file size are not admitted. They would evict many 
+ * small, hot files for a single large one, and are better streamed from disk.
+ */
+class FileCache
+{
+public:
+
+    /**
+     * @brief The number of independently locked shards.
+     */
+    static const size_t NUMBER_OF_SHARDS = 16;
+
+private:
+
+    typedef std::list<std::pair<std::string, std::shared_ptr<const CachedFile>>> LruList;
+
+    struct Shard
+    {
+        std::mutex mtx;
+
+        /**
+         * @brief The entries, most recently used first.
+         */
+        LruList lru;
+
+        /**
+         * @brief The keys view the paths stored in the list nodes, which never move.
+         */
+        std::unordered_map<std::string_view, LruList::iterator> index;
+
+        size_t bytes = 0;
+    };
+
+    Shard shards[NUMBER_OF_SHARDS];
+
+    size_t shardCapacity;
+
+    size_t maxFileSize;
+
+    Shard & shardOf(std::string_view path);
+
+    /**
+     * @brief Remove the entry from the shard. The lock of the shard must be held.
+     */
+    void eraseEntry(Shard &shard, LruList::iterator entry);
+
+public:
+
+    /**
+     * @param capacityBytes The total number of content bytes the cache may hold.
+     * 
+     * @param maxFileSize The largest file that is admitted to the cache.
+     */
+    FileCache(size_t capacityBytes, size_t maxFileSize);
+
+    FileCache(const FileCache &other) = delete;
+
+    FileCache & operator=(const FileCache &other) = delete;
+
+    /**
+     * @brief Get the cached content of the file and mark it as recently used.
+     * 
+     * @return The content or nullptr if the file is not cached.
+     */
+    std::shared_ptr<const CachedFile> get(std::string_view path);
+
+    /**
+     * @brief Check if a file of the given size would be admitted.
+     */
+    bool admits(size_t fileSize) const;
+
+    /**
+     * @brief Insert or replace the content of the file, evicting the least 
+     * recently used files of its shard until it fits.
+     * 
+     * @return True if the file was cached, false if it isn't admitted.
+     */
+    bool put(std::string_view path, std::shared_ptr<const CachedFile> file);
+
+    /**
+     * @brief Remove the file from the cache, if it is cached.
+     */
+    void erase(std::string_view path);
+
+    /**
+     * @brief Remove all files from the cache.
+     */
+    void clear();
+
+    /**
+     * @brief The number of content bytes currently cached.
+     */
+    size_t getCachedBytes();
+
+};
+
+#endif // _FILE_CACHE_HPP
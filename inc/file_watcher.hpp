@@ -0,0 +1,165 @@
+#ifndef _FILE_WATCHER_HPP
+#define _FILE_WATCHER_HPP
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "io_loop.hpp"
+
+/**
+ * @brief Watches directories with inotify and reports changed files, so caches
+ * can drop or reload their entries without a restart.
+ *
+ * Directories are watched instead of single files, since deployments usually 
+ * replace files by renaming a new file over the old one, which a watch on the 
+ * old file would not report. The inotify descriptor is driven by the IoLoop, so
+ * the callbacks run on the loop thread and must not block.
+ *
+ * A directory that is deleted or moved away (e.g. when a release directory is 
+ * swapped) is watched again by its path as soon as it exists again. Its callbacks 
+ * are called with an empty name both when the watch is lost and when it is back.
+ */
+class FileWatcher : private IoWaiter
+{
+public:
+
+    /**
+     * @brief Called when an entry of the watched directory was written, created,
+     * deleted, renamed or had its attributes changed. An empty name means that 
+     * any entry of the directory may have changed, e.g. after events were lost.
+     */
+    typedef std::function<void (const std::string &directory, std::string_view name)> Callback;
+
+private:
+
+    struct OwnedCallback
+    {
+        const void *owner;
+
+        Callback callback;
+    };
+
+    struct DirectoryWatch
+    {
+        std::string directory;
+
+        std::vector<OwnedCallback> callbacks;
+    };
+
+    /**
+     * @brief Calls retryLostWatches() on the loop thread.
+     */
+    struct RetryTimer : IoWaiter
+    {
+        FileWatcher &watcher;
+
+        RetryTimer(FileWatcher &watcher) : watcher{watcher} { }
+
+        void onReady() override;
+    };
+
+    /**
+     * @brief How often a lost directory is tried to be watched again.
+     */
+    static constexpr std::chrono::milliseconds RETRY_INTERVAL{1000};
+
+    int inotifyFd;
+
+    IoLoop &loop;
+
+    /**
+     * @brief The watched directories by their inotify watch descriptor.
+     * 
+     * NOTE: The access is not synchronized by default and the mtxWatches mutex must 
+     * be used to access this variable.
+     */
+    std::unordered_map<int, DirectoryWatch> watches;
+
+    /**
+     * @brief The directories whose watch was removed by the kernel and that 
+     * couldn't be watched again yet.
+     * 
+     * NOTE: The access is not synchronized by default and the mtxWatches mutex must 
+     * be used to access this variable.
+     */
+    std::vector<DirectoryWatch> lostWatches;
+
+    /**
+     * @brief True while the retry timer is pending.
+     * 
+     * NOTE: The access is not synchronized by default and the mtxWatches mutex must 
+     * be used to access this variable.
+     */
+    bool retryScheduled = false;
+
+    RetryTimer retryTimer{*this};
+
+    std::mutex mtxWatches;
+
+    /**
+     * @brief Read and dispatch all pending inotify events, then wait for the next.
+     */
+    void onReady() override;
+
+    void notify(int wd, std::string_view name);
+
+    /**
+     * @brief Add the callback, or replace the one of the same owner.
+     */
+    static void addCallback(std::vector<OwnedCallback> &callbacks, OwnedCallback callback);
+
+    /**
+     * @brief Move the watch to the lost watches after the kernel removed it, and 
+     * try to watch its directory again.
+     */
+    void loseWatch(int wd);
+
+    /**
+     * @brief Watch the lost directories again that exist by now. Schedules the 
+     * next try if some are still missing.
+     */
+    void retryLostWatches();
+
+    /**
+     * @brief Check after lost events that every watch still watches the 
+     * directory at its path.
+     */
+    void revalidateWatches();
+
+public:
+
+    FileWatcher(IoLoop &loop = IoLoop::getDefault());
+
+    FileWatcher(const FileWatcher &other) = delete;
+
+    FileWatcher & operator=(const FileWatcher &other) = delete;
+
+    ~FileWatcher();
+
+    /**
+     * @brief The watcher used by the file routes. It is created on first use and
+     * never destroyed, since callbacks may still run while static objects are
+     * destroyed at exit.
+     */
+    static FileWatcher & getDefault();
+
+    /**
+     * @brief Call the callback for every change in the directory. Subdirectories 
+     * are not watched.
+     * 
+     * @param owner If not null, replaces the callback that the same owner added 
+     *  for the directory before, so watching a directory again doesn't add up
+     *  callbacks.
+     * 
+     * @return False if the directory can't be watched.
+     */
+    bool watchDirectory(const std::string &directory, Callback callback, const void *owner = nullptr);
+
+};
+
+#endif // _FILE_WATCHER_HPP
@@ -0,0 +1,58 @@
+#ifndef _FRAME_POOL_HPP
+#define _FRAME_POOL_HPP
+
+#include <cstddef>
+
+/**
+ * @brief Allocator for coroutine frames.
+ *
+ * Frames are rounded up to size classes of SIZE_CLASS_STEP bytes. Freed frames are
+ * kept in a per-thread free list of their size class and reused by the next frame
+ * of the same class, so the steady state of a server doesn't call malloc for
+ * coroutine frames. Frames above MAX_POOLED_SIZE go directly to the heap.
+ *
+ * A frame may be freed on a different thread than it was allocated on (e.g. when
+ * the coroutine was resumed by the event loop). It then goes to the free list of
+ * the freeing thread, and once that list is full to a shared list, from which
+ * threads with an empty list take their frames. All lists are bounded, so memory
+ * doesn't pile up on one thread.
+ */
+class FramePool
+{
+public:
+
+    /**
+     * @brief The granularity of the size classes.
+     */
+    static const size_t SIZE_CLASS_STEP = 128;
+
+    /**
+     * @brief The largest frame that is pooled.
+     */
+    static const size_t MAX_POOLED_SIZE = 4096;
+
+    /**
+     * @brief The maximum number of free frames kept per size class and thread.
+     */
+    static const size_t MAX_FREE_PER_CLASS = 64;
+
+    /**
+     * @brief The maximum number of free frames kept per size class in the shared 
+     * list.
+     */
+    static const size_t MAX_SHARED_FREE_PER_CLASS = 256;
+
+    /**
+     * @brief Allocate memory for a frame of the given size.
+     */
+    static void * allocate(size_t size);
+
+    /**
+     * @brief Return the memory of a frame. The size must be the one that was 
+     * passed to allocate().
+     */
+    static void deallocate(void *frame, size_t size);
+
+};
+
+#endif // _FRAME_POOL_HPP
@@ -0,0 +1,41 @@
+#ifndef _FUTEX_HPP
+#define _FUTEX_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * @brief Sleep as long as the futex word has the expected value. The call may 
+ * return spuriously, so the caller must check the condition again.
+ * 
+ * @param word The futex word.
+ * 
+ * @param expected The value that must be stored in the word to go to sleep.
+ * 
+ * @param timeout Optional relative timeout (measured on CLOCK_MONOTONIC).
+ * 
+ * @see futex(2)
+ */
+inline void futexWait(std::atomic<uint32_t> *word, uint32_t expected, const timespec *timeout = nullptr)
+{
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex word must be 32 bits");
+
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT_PRIVATE, expected, timeout, nullptr, 0);
+}
+
+/**
+ * @brief Wake up to count threads that are sleeping on the futex word.
+ * 
+ * @see futex(2)
+ */
+inline void futexWake(std::atomic<uint32_t> *word, int count)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+}
+
+#endif // _FUTEX_HPP
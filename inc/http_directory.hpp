@@ -0,0 +1,69 @@
+#ifndef _HTTP_DIRECTORY_HPP
+#define _HTTP_DIRECTORY_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "http_route.hpp"
+
+/**
+ * @brief Options for serveDirectory().
+ */
+struct DirectoryOptions
+{
+    /**
+     * @brief The number of file content bytes kept in memory for the route.
+     */
+    size_t cacheBytes = 64 * 1024 * 1024;
+
+    /**
+     * @brief Files above this size are streamed from disk on every request 
+     * instead of being cached.
+     */
+    size_t maxCachedFileSize = 1024 * 1024;
+
+    /**
+     * @brief Map cached files from the page cache (see MappedFile) instead of 
+     * copying them into the heap. The memory is shared with the page cache and 
+     * other processes, and files are not read before they are sent. Files 
+     * below CachedFile::MIN_MAPPED_SIZE are still copied.
+     * 
+     * Deployments must replace mapped files by a rename. A file that is 
+     * rewritten in place is reloaded before the next response, but a response 
+     * that is being sent may get changed bytes or be cut off.
+     */
+    bool mapFiles = false;
+
+    /**
+     * @brief The file that is served for a request to a directory.
+     */
+    std::string indexFile = "index.html";
+
+    /**
+     * @brief Additional headers that are set on every response of the route.
+     */
+    std::vector<HttpHeader> setHeaders;
+};
+
+/**
+ * @brief Create a route that serves the files below the root directory for all 
+ * paths starting with prefix, e.g. prefix "/assets" and root "./static" serve 
+ * "/assets/css/main.css" from "./static/css/main.css".
+ * 
+ * The path segments are percent-decoded. Requests that contain ".." segments or 
+ * encoded slashes are answered with 404, so nothing outside of root is served.
+ * The Content-Type is taken from the file extension.
+ * 
+ * Small files are kept in a sharded, byte budgeted LRU cache (see FileCache), 
+ * large files are streamed from disk. The directories of cached files are 
+ * watched (see FileWatcher), so changed, moved or deleted files are dropped from 
+ * the cache and the next request loads them again.
+ * 
+ * Responses carry an ETag, and a matching If-None-Match is answered with 304 
+ * Not Modified.
+ */
+HttpRoute serveDirectory(const std::string &prefix, const std::string &root, 
+    const DirectoryOptions &options = DirectoryOptions{});
+
+#endif // _HTTP_DIRECTORY_HPP
@@ -14,7 +14,9 @@ public:
         InvalidIP,
         SocketBind,
         TcpAccept,
-        TcpSend
+        TcpSend,
+        TcpRecv,
+        FileRead
     };
 
 protected:
@@ -0,0 +1,65 @@
+#ifndef _HTTP_EXECUTOR_HPP
+#define _HTTP_EXECUTOR_HPP
+
+#include <atomic>
+#include <cstdint>
+
+#include "threadpool.hpp"
+
+/**
+ * @brief A dedicated pool of worker threads that route handlers can be bound to.
+ *
+ * Connections are accepted and parsed on the server workers. When a route that is
+ * bound to an executor matches, the rest of the request is handed to the executor.
+ * This isolates expensive routes: they can only occupy the threads of their own
+ * executor, while cheap routes keep being served by the server workers.
+ *
+ * The number of requests that run at the same time is limited by the number of
+ * threads, the number of requests waiting for a thread by the queue bound. If the
+ * queue is full, the request is rejected with 503 Service Unavailable instead of
+ * blocking the server worker.
+ */
+class HttpExecutor
+{
+private:
+
+    Threadpool pool;
+
+    std::atomic<uint64_t> rejectedRequests{0};
+
+public:
+
+    /**
+     * @param maxConcurrency The number of threads, which is the maximum number of
+     *  requests handled at the same time.
+     *
+     * @param maxQueued The maximum number of requests waiting for a thread, or 
+     *  Threadpool::DISABLE_MAX_QUEUE_BACKLOG to never reject requests.
+     */
+    HttpExecutor(int maxConcurrency, int maxQueued);
+
+    HttpExecutor(const HttpExecutor &other) = delete;
+
+    HttpExecutor & operator=(const HttpExecutor &other) = delete;
+
+    /**
+     * @brief Queue the task if the queue bound isn't reached.
+     *
+     * @return True if the task was queued, false if it was rejected.
+     */
+    bool trySubmit(Threadpool::Task &&task);
+
+    /**
+     * @brief Queue the task, waiting while the queue bound is reached. Used for 
+     * requests that can't be rejected anymore.
+     */
+    void submit(Threadpool::Task &&task);
+
+    /**
+     * @brief The number of requests that were rejected because the queue was full.
+     */
+    uint64_t getRejectedRequests() const;
+
+};
+
+#endif // _HTTP_EXECUTOR_HPP
@@ -1,8 +1,68 @@
 #ifndef _HTTP_HEADER_HPP
 #define _HTTP_HEADER_HPP
 
+#include <cstdint>
+#include <memory_resource>
 #include <string>
-#include <unordered_map>
+#include <string_view>
+
+#include "small_vector.hpp"
+
+/**
+ * @brief IDs of the well known headers, in the same order as the static name
+ * strings of HttpHeader. Headers with one of these names are found by an array
+ * index instead of comparing keys.
+ */
+enum class HeaderId : uint8_t
+{
+    Authorization,
+
+    Connection,
+    KeepAlive,
+
+    Accept,
+    AcceptCharset,
+    AcceptEncoding,
+
+    Cookie,
+    SetCookie,
+
+    ContentDisposition,
+
+    ContentLength,
+    ContentType,
+    ContentEncoding,
+    ContentLanguage,
+    ContentLocation,
+
+    Location,
+
+    Host,
+    Referer,
+    UserAgent,
+
+    Allow,
+    Server,
+
+    AcceptRanges,
+    Range,
+    ContentRange,
+
+    TransferEncoding,
+
+    Date,
+
+    ETag,
+    IfNoneMatch,
+
+    CacheControl,
+
+    /**
+     * @brief The number of well known headers. Also used as the ID of all other
+     * headers.
+     */
+    Unknown
+};
 
 class HttpHeader
 {
@@ -10,30 +70,54 @@ private:
 
     bool _isSet;
 
-    std::string key;
-    std::string value;
+    HeaderId id;
+
+    std::pmr::string key;
+    std::pmr::string value;
 
 public:
 
     HttpHeader();
 
-    HttpHeader(const std::string & key, const std::string & value);
+    HttpHeader(std::string_view key, std::string_view value, 
+        std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+
+    HttpHeader(HeaderId id, std::string_view value, 
+        std::pmr::memory_resource *resource = std::pmr::get_default_resource());
 
     const bool isSet() const;
 
-    const std::string & getKey() const;
+    HeaderId getId() const;
 
-    const std::string & getValue() const;
+    std::string_view getKey() const;
 
+    std::string_view getValue() const;
 
-    void setKey(const std::string & key);
 
-    void setValue(const std::string & value);
+    void setKey(std::string_view key);
+
+    void setValue(std::string_view value);
 
 
     friend class HttpHeaders;
 
 
+    /**
+     * @brief Map a header name to its well known ID, case insensitively.
+     * 
+     * Uses a perfect hash over the length and the first and last character of
+     * the name, so at most one key comparison is made.
+     * 
+     * @return The ID or HeaderId::Unknown.
+     */
+    static HeaderId lookupId(std::string_view name);
+
+    /**
+     * @brief Get the canonical name of a well known header.
+     */
+    static const std::string & name(HeaderId id);
+
+
     // https://developer.mozilla.org/en-US/docs/Web/HTTP/Headers
 
     static const std::string Authorization;
@@ -73,41 +157,188 @@ public:
 
     static const std::string Date;
 
+    static const std::string ETag;
+    static const std::string IfNoneMatch;
+
+    static const std::string CacheControl;
+
 };
 
 class HttpHeaders
 {
-private:
+public:
+
     /**
-     * @brief Statically allocated empty string to be used for empty values without
-     * the need for new allocations.
+     * @brief The number of headers that are stored without a heap allocation.
+     * Typical requests and responses carry 8 to 20 headers.
      */
-    const static std::string emptyString;
+    static const size_t INLINE_HEADERS = 16;
+
+    typedef SmallVector<HttpHeader, INLINE_HEADERS> HeaderList;
 
+private:
     /**
      * @brief Statically allocated empty header to be used for empty values without
      * the need for new allocations.
      */
     const static HttpHeader emptyHeader;
 
-    std::unordered_map<std::string, HttpHeader> _headers;
+    /**
+     * @brief The headers in the order they were added. Keys keep their original
+     * case and lookups are a linear scan with keyEquals, which beats hashing for
+     * the handful of headers a message has. A key can appear multiple times.
+     */
+    HeaderList _headers;
+
+    /**
+     * @brief The memory resource the keys and values are allocated from.
+     */
+    std::pmr::memory_resource *resource;
+
+    /**
+     * @brief Index + 1 into _headers of the first header for each well known
+     * ID, 0 if there is none.
+     */
+    uint16_t slots[(size_t)HeaderId::Unknown] = {};
+
+    /**
+     * @brief Find the first header with the given key.
+     * 
+     * @return The header or nullptr if it doesn't exist.
+     */
+    const HttpHeader * findHeader(std::string_view key) const;
+
+    const HttpHeader * findHeader(HeaderId id) const;
+
+    /**
+     * @brief Rebuild the slots after headers were removed from the list.
+     */
+    void reindex();
+
+    /**
+     * @brief Append a header and fill its slot if it is the first with its ID.
+     */
+    void append(HttpHeader && header);
+
+    /**
+     * @brief Remove all headers with the ID and key of header behind the one at
+     * index first.
+     */
+    void eraseDuplicates(size_t first);
 
 public:
 
-    const HttpHeader & getHeader(const std::string & key) const;
+    /**
+     * @brief Create an empty header list that allocates from the given memory
+     * resource. The headers must not outlive the resource.
+     */
+    HttpHeaders(std::pmr::memory_resource *resource = std::pmr::get_default_resource());
 
-    const bool headerExists(const std::string & key) const;
+    /**
+     * @brief Copy the headers into the default memory resource, so the copy can
+     * outlive the resource of other.
+     */
+    HttpHeaders(const HttpHeaders & other);
+
+    HttpHeaders(HttpHeaders && other) = default;
+
+    HttpHeaders & operator=(const HttpHeaders & other);
+
+    HttpHeaders & operator=(HttpHeaders && other) = default;
+
+    std::pmr::memory_resource * getResource() const;
+
+    /**
+     * @brief Compare two header keys case insensitively without copying them.
+     * 
+     * The keys are compared 8 bytes at a time, converting ASCII upper case
+     * letters to lower case inside the word.
+     */
+    static bool keyEquals(std::string_view a, std::string_view b);
 
-    const std::string & getValueOrEmpty(const std::string & key) const;
+    /**
+     * @brief Get the first header with the given key, or an empty header with
+     * isSet() false.
+     */
+    const HttpHeader & getHeader(std::string_view key) const;
 
-    const std::unordered_map<std::string, HttpHeader> & getRawHeaders() const;
+    /**
+     * @brief Get the first header with a well known ID. This is an array index.
+     */
+    const HttpHeader & get(HeaderId id) const;
 
+    const bool headerExists(std::string_view key) const;
 
+    const bool headerExists(HeaderId id) const;
+
+    std::string_view getValueOrEmpty(std::string_view key) const;
+
+    std::string_view getValueOrEmpty(HeaderId id) const;
+
+    /**
+     * @brief Call fn with the value of every header with the given key, in the
+     * order they were added. This is how repeated headers like Set-Cookie are
+     * read.
+     */
+    template <typename Fn>
+    void forEachValue(std::string_view key, Fn &&fn) const
+    {
+        HeaderId id = HttpHeader::lookupId(key);
+
+        for (const auto &h : _headers)
+        {
+            if (h.id == id && (id != HeaderId::Unknown || keyEquals(h.key, key)))
+                fn(std::string_view(h.value));
+        }
+    }
+
+    /**
+     * @brief Same as forEachValue() with a key, but for a well known header.
+     */
+    template <typename Fn>
+    void forEachValue(HeaderId id, Fn &&fn) const
+    {
+        if (slots[(size_t)id] == 0)
+            return;
+
+        for (size_t i = slots[(size_t)id] - 1; i < _headers.size(); i++)
+        {
+            if (_headers[i].id == id)
+                fn(std::string_view(_headers[i].value));
+        }
+    }
+
+    /**
+     * @brief Get all headers in the order they were added, including repeated
+     * keys.
+     */
+    const HeaderList & getRawHeaders() const;
+
+
+    /**
+     * @brief Set a header, replacing all existing headers with the same key.
+     */
     void setHeader(const HttpHeader & header);
 
-    void setHeader(const std::string & key, const std::string & value);
+    /**
+     * @brief Set a header, replacing all existing headers with the same key.
+     */
+    void setHeader(std::string_view key, std::string_view value);
+
+    void setHeader(HeaderId id, std::string_view value);
+
+    /**
+     * @brief Add a header without replacing existing headers with the same key,
+     * e.g. for multiple Set-Cookie headers.
+     */
+    void addHeader(std::string_view key, std::string_view value);
+
+    /**
+     * @brief Remove all headers with the given key.
+     */
+    void unsetHeader(std::string_view key);
 
-    void unsetHeader(const std::string & key);
+    void unsetHeader(HeaderId id);
 
 };
 
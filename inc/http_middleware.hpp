@@ -0,0 +1,40 @@
+#ifndef _HTTP_MIDDLEWARE_HPP
+#define _HTTP_MIDDLEWARE_HPP
+
+#include <chrono>
+
+#include "inplace_function.hpp"
+#include "http_route.hpp"
+
+/**
+ * @brief Hook that is called for every request before the routes are matched.
+ * Returning HttpRouteHandling::End stops the request from reaching the routes,
+ * e.g. when an authentication check failed and the hook already responded.
+ */
+typedef InplaceFunction<
+    HttpRouteHandling (const HttpRequest &req, HttpResponse &res)
+> HttpBeforeHook;
+
+/**
+ * @brief Hook that is called for every request after the response was sent. The
+ * response can be inspected for the status and the number of bytes sent.
+ */
+typedef InplaceFunction<
+    void (const HttpRequest &req, const HttpResponse &res, std::chrono::microseconds latency)
+> HttpAfterHook;
+
+/**
+ * @brief A middleware consisting of an optional before-handler hook and an
+ * optional after-response hook.
+ *
+ * Middleware runs outside of the route matching. The hooks are stored inline in
+ * a flat list by the server, so calling them doesn't allocate.
+ */
+struct HttpMiddleware
+{
+    HttpBeforeHook before;
+
+    HttpAfterHook after;
+};
+
+#endif // _HTTP_MIDDLEWARE_HPP
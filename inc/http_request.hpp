@@ -1,16 +1,120 @@
 #ifndef _HTTP_REQUEST_HPP
 #define _HTTP_REQUEST_HPP
 
+#include <forward_list>
+#include <memory_resource>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 #include <unordered_map>
 
 #include "http_header.hpp"
+#include "async_io.hpp"
+
+/**
+ * @brief The body of a request, read asynchronously by coroutine handlers.
+ *
+ * The body length is taken from the Content-Length header. Body data that was 
+ * already received together with the head is returned first.
+ */
+class HttpRequestBody
+{
+private:
+
+    int sockfd = -1;
+
+    /**
+     * @brief Body data that was received together with the head.
+     */
+    std::pmr::vector<uint8_t> buffered;
+
+    size_t bufferedOffset = 0;
+
+    /**
+     * @brief The number of body bytes that are still to be read from the socket.
+     */
+    size_t remainingOnSocket = 0;
+
+    /**
+     * @brief Set up the body after the head was parsed.
+     */
+    void init(int sockfd, std::pmr::vector<uint8_t> &&buffered, size_t contentLength);
+
+public:
+
+    HttpRequestBody(std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+
+    /**
+     * @brief Read the next part of the body into the buffer. 
+     * 
+     * Usage: size_t n = co_await req.body().read(buff, sizeof(buff));
+     * 
+     * @return Awaitable that results in the number of bytes read, or 0 once the 
+     *  whole body was read.
+     */
+    AsyncRead read(uint8_t *buffer, size_t bufferLength);
+
+    /**
+     * @brief The number of body bytes that were not read yet.
+     */
+    size_t remaining() const;
+
+    friend class HttpServer;
+};
 
 class HttpRequest
 {
+public:
+
+    typedef SmallVector<std::string_view, 8> SegmentList;
+
+    typedef SmallVector<std::pair<std::string_view, std::string_view>, 8> ParamList;
+
 private:
 
+    /**
+     * @brief The lazily parsed parts of the target and the cookies. Each part is
+     * parsed on first access, so requests that never look at them pay nothing.
+     * The views point into _uri, the headers or decoded. 
+     * 
+     * A copy starts unparsed, since the views of the original point into the 
+     * other request.
+     */
+    struct ParsedTarget
+    {
+        bool segmentsParsed = false;
+        bool queryParsed = false;
+        bool cookiesParsed = false;
+
+        SegmentList segments;
+        ParamList query;
+        ParamList cookies;
+
+        /**
+         * @brief Storage for values that contained percent escapes. The list 
+         * nodes never move, so views into the strings stay valid.
+         */
+        std::pmr::forward_list<std::pmr::string> decoded;
+
+        ParsedTarget(std::pmr::memory_resource *resource)
+            : decoded{resource}
+        { }
+
+        ParsedTarget(const ParsedTarget &)
+        { }
+
+        ParsedTarget & operator=(const ParsedTarget &)
+        {
+            segmentsParsed = queryParsed = cookiesParsed = false;
+            segments.clear();
+            query.clear();
+            cookies.clear();
+            decoded.clear();
+            return *this;
+        }
+    };
+
     std::string _ip;
     int _port;
 
@@ -22,25 +126,93 @@ private:
 
     std::vector<std::string> _regexMatches;
 
+    HttpRequestBody _body;
+
+    /**
+     * @brief Only one thread handles a request at a time, so the const accessors
+     * can fill the cache without locking.
+     */
+    mutable ParsedTarget parsed;
+
+    /**
+     * @brief Percent-decode the value. Values without escapes are returned as they 
+     * are, without a copy.
+     * 
+     * @param plusIsSpace Decode '+' as a space, as in query strings.
+     */
+    std::string_view decode(std::string_view raw, bool plusIsSpace) const;
+
 public:
 
+    /**
+     * @brief Create an empty request. The headers and the buffered body are 
+     * allocated from the given memory resource, which must outlive the request.
+     */
+    HttpRequest(std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+
     const std::string & ip() const;
 
     int port() const;
 
     const std::string & method() const;
 
+    /**
+     * @brief The raw request target, including the query string.
+     */
     const std::string & uri() const;
 
+    /**
+     * @brief The target without the query string. The path is not decoded.
+     */
+    std::string_view path() const;
+
+    /**
+     * @brief The raw query string after the '?', or empty.
+     */
+    std::string_view queryString() const;
+
+    /**
+     * @brief Get the decoded value of the first query parameter with the decoded 
+     * name key, or empty if it doesn't exist.
+     */
+    std::string_view query(std::string_view key) const;
+
+    /**
+     * @brief Get all query parameters as decoded name value pairs, in order.
+     */
+    const ParamList & queryParams() const;
+
+    /**
+     * @brief Get the value of the cookie with the name key from the Cookie 
+     * headers, or empty if it doesn't exist. Percent escapes are decoded.
+     */
+    std::string_view cookie(std::string_view key) const;
+
+    /**
+     * @brief Get all cookies as name value pairs, in order.
+     */
+    const ParamList & cookies() const;
+
+    /**
+     * @brief The decoded, non empty segments of the path. "/a/b%20c/" results in 
+     * "a" and "b c".
+     */
+    const SegmentList & pathSegments() const;
+
     const std::string & httpver() const;
 
     const HttpHeaders & headers() const;
 
     const std::vector<std::string> & regexMatches() const;
 
+    /**
+     * @brief The request body for coroutine handlers.
+     */
+    HttpRequestBody & body();
+
     friend class HttpServer;
-    friend bool parse_headers_into(const std::string &head_text, HttpRequest &req);
-    friend bool parse_requestline_into(const std::string &head_text, HttpRequest &req);
+    friend bool parse_headers_into(std::string_view head_text, HttpRequest &req);
+    friend bool parse_requestline_into(std::string_view head_text, HttpRequest &req);
 };
 
 #endif // _HTTP_REQUEST_HPP
\ No newline at end of file
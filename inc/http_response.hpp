@@ -1,10 +1,12 @@
 #ifndef _HTTP_RESPONSE_HPP
 #define _HTTP_RESPONSE_HPP
 
+#include <memory_resource>
 #include <string>
 #include <unordered_map>
 
 #include "http_header.hpp"
+#include "async_io.hpp"
 
 
 class HttpResponse
@@ -21,11 +23,30 @@ private:
 
     HttpHeaders headers;
 
+    size_t bytesSent = 0;
+
+    bool headSent = false;
+
+    /**
+     * @brief If set, everything written to the socket is appended here as well.
+     */
+    std::string *capture = nullptr;
+
+    /**
+     * @brief Build the status line and headers. The string is allocated from the
+     * memory resource of the headers.
+     */
+    std::pmr::string buildHead() const;
+
     void rawWriteAll(int sockfd, const uint8_t *data, size_t dataLength);
 
 public:
 
-    HttpResponse(int sockfd);
+    /**
+     * @brief Create a response for the socket. The headers and the head are 
+     * allocated from the given memory resource, which must outlive the response.
+     */
+    HttpResponse(int sockfd, std::pmr::memory_resource *resource = std::pmr::get_default_resource());
 
     void setStatus(uint16_t statusCode, std::string statusPhrase = "");
 
@@ -33,6 +54,10 @@ public:
 
     HttpHeaders & getHeadersWritable();
 
+    uint16_t getStatus() const;
+
+    size_t getBytesSent() const;
+
     void sendHeader();
 
     void sendAll(const uint8_t *bodyData, size_t bodyLength);
@@ -41,8 +66,35 @@ public:
 
     void sendBody(const uint8_t *bodyData, size_t bodyLength);
 
+    /**
+     * @brief Write the data without blocking a thread, for coroutine handlers. The
+     * head is written before the first data. The data must stay valid until the 
+     * write has finished.
+     * 
+     * Usage: co_await res.write(data, length);
+     */
+    AsyncWrite write(const uint8_t *data, size_t dataLength);
+
+    /**
+     * @brief Send a complete, already serialized response (head and body) as it 
+     * is, e.g. a response that was captured before.
+     */
+    void sendRaw(const uint8_t *data, size_t dataLength);
+
+    /**
+     * @brief Append everything that is sent from now on to the buffer, so the 
+     * serialized response can be replayed with sendRaw(). Pass nullptr to stop.
+     * Data written asynchronously with write() is not captured.
+     * 
+     * @return The buffer that was capturing before. A nested capture has to 
+     *  restore it and append its own data to it, if it is set.
+     */
+    std::string * captureTo(std::string *buffer);
+
     void sendDefault404();
 
+    void sendDefault503();
+
     friend class HttpServer;
 
 };
@@ -2,11 +2,14 @@
 #define _HTTP_ROUTE_HPP
 
 #include <functional>
+#include <memory>
 #include <string>
 #include <regex>
 
 #include "http_request.hpp"
 #include "http_response.hpp"
+#include "http_executor.hpp"
+#include "http_task.hpp"
 
 enum class HttpRouteHandling
 {
@@ -22,6 +25,13 @@ enum class HttpRouteHandling
 
 typedef std::function<HttpRouteHandling (const HttpRequest &req, HttpResponse &res)> HttpHandlerFn;
 
+/**
+ * @brief Coroutine route handler. The request is writable so the body can be read.
+ * 
+ * @see HttpTask
+ */
+typedef std::function<HttpTask (HttpRequest &req, HttpResponse &res)> HttpAsyncHandlerFn;
+
 class HttpRoute
 {
 public:
@@ -43,14 +53,45 @@ private:
 
     HttpHandlerFn handler_fn;
 
+    HttpAsyncHandlerFn async_handler_fn;
+
+    std::shared_ptr<HttpExecutor> executor;
+
 public:
     HttpRoute(const std::string &route, HttpHandlerFn handler, 
         HttpRoute::MatchType matchType = HttpRoute::MatchType::Regex);
 
+    /**
+     * @brief Create a route with a coroutine handler.
+     */
+    HttpRoute(const std::string &route, HttpAsyncHandlerFn handler, 
+        HttpRoute::MatchType matchType = HttpRoute::MatchType::Regex);
+
     const std::string & getRoute() const;
 
     const HttpRoute::MatchType & getMatchType() const;
 
+    /**
+     * @brief Run the handler on the given executor instead of the server workers.
+     * If the handler continues the route matching, the following routes are 
+     * matched on the executor as well. Pass nullptr to run on the server workers.
+     * 
+     * @return The route itself, so the call can be chained when adding the route.
+     */
+    HttpRoute & setExecutor(std::shared_ptr<HttpExecutor> executor);
+
+    const std::shared_ptr<HttpExecutor> & getExecutor() const;
+
+    /**
+     * @brief Replace the handler with the one returned by wrapper, which gets the
+     * current handler to call, e.g. to cache its responses.
+     * 
+     * @return The route itself, so the call can be chained when adding the route.
+     * 
+     * @throws std::runtime_error for a coroutine handler, which can't be wrapped.
+     */
+    HttpRoute & wrapHandler(const std::function<HttpHandlerFn (HttpHandlerFn handler)> &wrapper);
+
     friend class HttpServer;
 
 };
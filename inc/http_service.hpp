@@ -1,11 +1,16 @@
 #ifndef _HTTP_SERVICE_HPP
 #define _HTTP_SERVICE_HPP
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
 #include <string>
-#include <fstream>
 
+#include "buffer_pool.hpp"
 #include "http_route.hpp"
-
+#include "file_cache.hpp"
+#include "file_watcher.hpp"
+#include "open_file_cache.hpp"
 
 
 HttpRoute serveFile(
@@ -14,45 +19,75 @@ HttpRoute serveFile(
     const std::vector<HttpHeader> setHeaders = std::vector<HttpHeader>{}
 )
 {
+    // The descriptor is kept open in the open file cache. Changes in the directory
+    // drop it right away, including the negative lookup when the file is created
+    size_t slash = filePath.rfind('/');
+    std::string directory = slash == std::string::npos ? "." : filePath.substr(0, slash);
+    std::string fileName = slash == std::string::npos ? filePath : filePath.substr(slash + 1);
+
+    FileWatcher::getDefault().watchDirectory(directory, 
+        [filePath, fileName] (const std::string &, std::string_view name) {
+            if (name.empty() || name == fileName)
+                OpenFileCache::getDefault().erase(filePath);
+        }
+    );
+
+    // The body is read with AsyncFileRead, so a worker never waits for the disk. 
+    // Only the lookup in the open file cache may touch the filesystem
     return HttpRoute (
         route,
-        [filePath, contentType, setHeaders] (const HttpRequest &req, HttpResponse res) {
+        [filePath, contentType, setHeaders] (HttpRequest &req, HttpResponse &res) -> HttpTask {
 
-            std::ifstream inputFile(filePath, std::ios::binary);
+            std::shared_ptr<const OpenFile> file = OpenFileCache::getDefault().open(filePath);
 
-            if (inputFile.fail())
+            if (!file)
             {
                 res.sendDefault404();
-                return HttpRouteHandling::End;
+                co_return HttpRouteHandling::End;
             }
 
-            // This is not a good way to get the filesize
-            auto fsize_beg = inputFile.tellg();
-            inputFile.seekg(0, std::ios::end);
-            auto fsize_end = inputFile.tellg();
-            auto filesize = fsize_end-fsize_beg;
-            inputFile.seekg(0, std::ios::beg);
+            res.getHeadersWritable().setHeader(HeaderId::ETag, file->etag());
 
-            res.getHeadersWritable().setHeader("Content-Type", contentType);
-            res.getHeadersWritable().setHeader("Content-Length", std::to_string(filesize));
-
-            
             for (const auto &h : setHeaders)
             {
                 res.getHeadersWritable().setHeader(h.getKey(), h.getValue());
             }
 
-            res.sendHeader();
+            if (CachedFile::matchesETag(req.headers().getValueOrEmpty(HeaderId::IfNoneMatch), file->etag()))
+            {
+                res.setStatus(304, "Not Modified");
+                res.getHeadersWritable().unsetHeader(HeaderId::ContentType);
+                co_await res.write(nullptr, 0);
+                co_return HttpRouteHandling::End;
+            }
 
-            uint8_t buffer[4096];
-            ssize_t bytes_read = 0;
+            res.getHeadersWritable().setHeader(HeaderId::ContentType, contentType);
+            res.getHeadersWritable().setHeader(HeaderId::ContentLength, std::to_string(file->size()));
 
-            while((bytes_read = inputFile.readsome((char*)buffer, 4096)) > 0)
+            // The descriptor is shared with other requests, so the reads must not use 
+            // the file position. A file that shrinks while it is sent ends the body early.
+            // The buffer is not part of the frame, which then stays small enough for FramePool
+            BufferPool::Buffer buffer = BufferPool::acquire();
+            size_t offset = 0;
+
+            if (file->size() == 0)
+                co_await res.write(nullptr, 0);
+
+            while (offset < file->size())
             {
-                res.sendBody(buffer, bytes_read);
+                size_t length = std::min(buffer.size(), file->size() - offset);
+
+                size_t bytes_read = co_await AsyncFileRead(file->descriptor(), buffer.data(), length, offset, buffer.size());
+
+                if (bytes_read == 0)
+                    break;
+
+                // The head is written with the first chunk
+                co_await res.write(buffer.data(), bytes_read);
+                offset += bytes_read;
             }
 
-            return HttpRouteHandling::End;
+            co_return HttpRouteHandling::End;
         },
         matchType
     );
@@ -64,45 +99,107 @@ HttpRoute serveFileCached(
     const std::vector<HttpHeader> setHeaders = std::vector<HttpHeader>{}
 )
 {
-    std::ifstream inputFile(filePath, std::ios::binary);
-
-    bool found = !inputFile.fail();
-
-    std::vector<uint8_t> data;
-
-    if (found)
+    // The file is mapped on the first request instead of being read at launch. The
+    // content is served directly from the page cache. Small files are copied. 
+    // Deployments must replace the file by a rename, a file that is rewritten in 
+    // place can change the bytes of a response that is being sent
+    struct Snapshot
     {
-        uint8_t buffer[4096];
-        ssize_t bytes_read = 0;
-
-        while((bytes_read = inputFile.readsome((char*)buffer, 4096)) > 0)
-        {
-            data.insert(data.end(), std::begin(buffer), std::begin(buffer) + bytes_read);
-        }
-
-    }
+        std::atomic<std::shared_ptr<const CachedFile>> file;
+
+        /**
+         * @brief The number of changes reported by the watcher, so a load that 
+         * raced with a change is not kept.
+         */
+        std::atomic<uint64_t> changes{0};
+    };
+
+    auto snapshot = std::make_shared<Snapshot>();
+
+    // Drop the file when it changes, the next request loads it again. The watcher 
+    // runs on the loop thread, so it must not read the file itself. Responses that 
+    // are being sent keep the snapshot they started with
+    size_t slash = filePath.rfind('/');
+    std::string directory = slash == std::string::npos ? "." : filePath.substr(0, slash);
+    std::string fileName = slash == std::string::npos ? filePath : filePath.substr(slash + 1);
+
+    FileWatcher::getDefault().watchDirectory(directory, 
+        [weakSnapshot = std::weak_ptr<Snapshot>(snapshot), fileName] 
+        (const std::string &, std::string_view name) {
+            auto snapshot = weakSnapshot.lock();
+
+            if (snapshot && (name.empty() || name == fileName))
+            {
+                snapshot->changes.fetch_add(1);
+                snapshot->file.store(nullptr);
+            }
+        },
+        snapshot.get()
+    );
 
     return HttpRoute (
         route,
-        [filePath, contentType, setHeaders, data, found] (const HttpRequest &req, HttpResponse res) {
+        [filePath, contentType, setHeaders, snapshot] (const HttpRequest &req, HttpResponse &res) {
 
-            if (!found)
+            std::shared_ptr<const CachedFile> data = snapshot->file.load(std::memory_order_acquire);
+
+            if (data && !data->isUnchanged())
             {
-                res.sendDefault404();
-                return HttpRouteHandling::End;
+                // Rewritten in place and not reported by the watcher yet, so the 
+                // mapping may not match the size anymore. Load the file again
+                std::shared_ptr<const CachedFile> changed = data;
+                snapshot->file.compare_exchange_strong(changed, std::shared_ptr<const CachedFile>());
+                data = nullptr;
             }
 
-            res.getHeadersWritable().setHeader("Content-Type", contentType);
-            res.getHeadersWritable().setHeader("Content-Length", std::to_string(data.size()));
+            if (!data)
+            {
+                // A missing file is looked up again on the next request
+                uint64_t changes = snapshot->changes.load();
+                data = CachedFile::load(filePath, contentType, true);
+
+                if (!data)
+                {
+                    res.sendDefault404();
+                    return HttpRouteHandling::End;
+                }
+
+                // Concurrent first requests may both map the file, only one is kept
+                std::shared_ptr<const CachedFile> expected;
+                if (!snapshot->file.compare_exchange_strong(expected, data))
+                {
+                    data = expected;
+                }
+                else if (snapshot->changes.load() != changes)
+                {
+                    // The file changed while it was loaded, this response may still 
+                    // use it but the next request loads it again
+                    expected = data;
+                    snapshot->file.compare_exchange_strong(expected, std::shared_ptr<const CachedFile>());
+                }
+            }
+
+            res.getHeadersWritable().setHeader(HeaderId::ETag, data->etag());
 
             for (const auto &h : setHeaders)
             {
                 res.getHeadersWritable().setHeader(h.getKey(), h.getValue());
             }
 
+            if (CachedFile::matchesETag(req.headers().getValueOrEmpty(HeaderId::IfNoneMatch), data->etag()))
+            {
+                res.setStatus(304, "Not Modified");
+                res.getHeadersWritable().unsetHeader(HeaderId::ContentType);
+                res.sendHeader();
+                return HttpRouteHandling::End;
+            }
+
+            res.getHeadersWritable().setHeader(HeaderId::ContentType, contentType);
+            res.getHeadersWritable().setHeader(HeaderId::ContentLength, std::to_string(data->size()));
+
             res.sendHeader();
 
-            res.sendBody(data.data(), data.size());
+            res.sendBody(data->data(), data->size());
 
             return HttpRouteHandling::End;
         },
@@ -0,0 +1,281 @@
+#ifndef _HTTP_STATIC_ROUTE_HPP
+#define _HTTP_STATIC_ROUTE_HPP
+
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <tuple>
+#include <utility>
+
+#include "http_route.hpp"
+
+typedef HttpRouteHandling (*HttpHandlerPtr)(const HttpRequest &req, HttpResponse &res);
+
+/**
+ * @brief A literal route with a handler that is known at compile time.
+ *
+ * Since the handler is a template parameter, calling it is a direct function call
+ * that the compiler can inline, instead of going through a std::function.
+ *
+ * @tparam Handler The handler function for this route.
+ */
+template <HttpHandlerPtr Handler>
+struct StaticRoute
+{
+    /**
+     * @brief The literal uri that is matched by this route.
+     */
+    std::string_view route;
+
+    constexpr StaticRoute(std::string_view route)
+        : route{route}
+    { }
+
+    static HttpRouteHandling invoke(const HttpRequest &req, HttpResponse &res)
+    {
+        return Handler(req, res);
+    }
+};
+
+/**
+ * @brief A route table for literal routes that are fixed at compile time.
+ *
+ * The table builds a minimal perfect hash (hash and displace) over all route
+ * strings while constructing the table in a constexpr context. Dispatching a uri
+ * then costs one hash over the uri, two array lookups, one string comparison and
+ * a direct call of the handler.
+ *
+ * Example:
+ * @code
+ * constexpr StaticRouteTable routes {
+ *     StaticRoute<&handle_ping>{"/ping"},
+ *     StaticRoute<&handle_version>{"/version"}
+ * };
+ * srv.addRoute(routes.asRoute());
+ * @endcode
+ *
+ * @tparam Routes The StaticRoute types, one for each route.
+ */
+template <typename... Routes>
+class StaticRouteTable
+{
+public:
+
+    /**
+     * @brief The number of routes in the table.
+     */
+    static constexpr size_t numberOfRoutes = sizeof...(Routes);
+
+private:
+
+    static_assert(numberOfRoutes > 0, "StaticRouteTable needs at least one route");
+    static_assert(numberOfRoutes < 255, "StaticRouteTable supports at most 254 routes");
+
+    static constexpr size_t nextPowerOfTwo(size_t n)
+    {
+        size_t p = 1;
+        while (p < n) p <<= 1;
+        return p;
+    }
+
+    /**
+     * @brief The number of first level buckets. Every bucket stores the
+     * displacement that is used for its routes.
+     */
+    static constexpr size_t numberOfBuckets = nextPowerOfTwo(numberOfRoutes);
+
+    /**
+     * @brief The number of route slots. Using twice as many slots as routes
+     * keeps the displacement search short.
+     */
+    static constexpr size_t numberOfSlots = nextPowerOfTwo(numberOfRoutes * 2);
+
+    /**
+     * @brief Marker for slots that don't contain a route.
+     */
+    static constexpr uint8_t EMPTY_SLOT = 0xff;
+
+    std::array<std::string_view, numberOfRoutes> routes;
+
+    std::array<uint32_t, numberOfBuckets> displacements;
+
+    std::array<uint8_t, numberOfSlots> slots;
+
+    /**
+     * @brief FNV-1a hash over the string. This is only computed once per lookup.
+     */
+    static constexpr uint64_t hashString(std::string_view str)
+    {
+        uint64_t h = 0xcbf29ce484222325ULL;
+        for (char c : str)
+        {
+            h ^= static_cast<uint8_t>(c);
+            h *= 0x100000001b3ULL;
+        }
+        return h;
+    }
+
+    /**
+     * @brief Finalizer from splitmix64 to derive the bucket and slot positions
+     * from the string hash.
+     */
+    static constexpr uint64_t mix(uint64_t h)
+    {
+        h ^= h >> 30;
+        h *= 0xbf58476d1ce4e5b9ULL;
+        h ^= h >> 27;
+        h *= 0x94d049bb133111ebULL;
+        h ^= h >> 31;
+        return h;
+    }
+
+    static constexpr size_t bucketOf(uint64_t h)
+    {
+        return mix(h) & (numberOfBuckets - 1);
+    }
+
+    static constexpr size_t slotOf(uint64_t h, uint32_t displacement)
+    {
+        return mix(h ^ (displacement * 0x9e3779b97f4a7c15ULL)) & (numberOfSlots - 1);
+    }
+
+    /**
+     * @brief Search a displacement for every bucket, so that all routes end up
+     * in distinct slots. Buckets with more routes are placed first, since they
+     * are the hardest to fit.
+     */
+    constexpr void buildPerfectHash()
+    {
+        std::array<uint64_t, numberOfRoutes> hashes{};
+        std::array<size_t, numberOfBuckets> bucketSizes{};
+
+        for (size_t i = 0; i < numberOfRoutes; i++)
+        {
+            for (size_t j = 0; j < i; j++)
+            {
+                if (routes[i] == routes[j])
+                    throw std::logic_error("StaticRouteTable contains a route twice");
+            }
+
+            hashes[i] = hashString(routes[i]);
+            bucketSizes[bucketOf(hashes[i])]++;
+        }
+
+        for (auto &s : slots) s = EMPTY_SLOT;
+        for (auto &d : displacements) d = 0;
+
+        for (size_t size = numberOfRoutes; size > 0; size--)
+        {
+            for (size_t bucket = 0; bucket < numberOfBuckets; bucket++)
+            {
+                if (bucketSizes[bucket] != size)
+                    continue;
+
+                for (uint32_t displacement = 1; ; displacement++)
+                {
+                    if (displacement == 0x100000)
+                        throw std::logic_error("StaticRouteTable could not build a perfect hash");
+
+                    std::array<uint8_t, numberOfSlots> candidate = slots;
+                    bool fits = true;
+
+                    for (size_t i = 0; i < numberOfRoutes && fits; i++)
+                    {
+                        if (bucketOf(hashes[i]) != bucket)
+                            continue;
+
+                        size_t slot = slotOf(hashes[i], displacement);
+                        if (candidate[slot] != EMPTY_SLOT)
+                            fits = false;
+                        else
+                            candidate[slot] = static_cast<uint8_t>(i);
+                    }
+
+                    if (fits)
+                    {
+                        slots = candidate;
+                        displacements[bucket] = displacement;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Call the handler of the route with the given index. The fold
+     * expression is compiled into a switch with direct calls.
+     */
+    template <size_t... I>
+    static HttpRouteHandling invokeRoute(size_t index, const HttpRequest &req, HttpResponse &res,
+        std::index_sequence<I...>)
+    {
+        HttpRouteHandling handling = HttpRouteHandling::Continue;
+
+        ((index == I
+            ? (handling = std::tuple_element_t<I, std::tuple<Routes...>>::invoke(req, res), true)
+            : false) || ...);
+
+        return handling;
+    }
+
+public:
+
+    constexpr StaticRouteTable(Routes... routes)
+        : routes{routes.route...}, displacements{}, slots{}
+    {
+        buildPerfectHash();
+    }
+
+    /**
+     * @brief Find the index of the route matching the uri.
+     *
+     * @return The index of the route in the order of construction or -1 if no
+     *  route matches.
+     */
+    constexpr int find(std::string_view uri) const
+    {
+        uint64_t h = hashString(uri);
+        uint8_t index = slots[slotOf(h, displacements[bucketOf(h)])];
+
+        if (index == EMPTY_SLOT || routes[index] != uri)
+            return -1;
+
+        return index;
+    }
+
+    /**
+     * @brief Call the handler of the route that matches the request path.
+     *
+     * @return The handling returned by the handler, or HttpRouteHandling::Continue
+     *  if no route matches.
+     */
+    HttpRouteHandling dispatch(const HttpRequest &req, HttpResponse &res) const
+    {
+        int index = find(req.path());
+
+        if (index < 0)
+            return HttpRouteHandling::Continue;
+
+        return invokeRoute(index, req, res, std::index_sequence_for<Routes...>{});
+    }
+
+    /**
+     * @brief Wrap the table into a single HttpRoute that can be added to the server.
+     * The std::function of the HttpRoute is only called once for the whole table.
+     */
+    HttpRoute asRoute() const
+    {
+        return HttpRoute(
+            "",
+            [table = *this] (const HttpRequest &req, HttpResponse &res) {
+                return table.dispatch(req, res);
+            },
+            HttpRoute::MatchType::MatchAny
+        );
+    }
+
+};
+
+#endif // _HTTP_STATIC_ROUTE_HPP
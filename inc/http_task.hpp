@@ -0,0 +1,138 @@
+#ifndef _HTTP_TASK_HPP
+#define _HTTP_TASK_HPP
+
+#include <coroutine>
+#include <exception>
+#include <utility>
+
+#include "frame_pool.hpp"
+#include "inplace_function.hpp"
+
+enum class HttpRouteHandling;
+
+/**
+ * @brief The return type of coroutine route handlers.
+ *
+ * A coroutine handler co_awaits asynchronous operations like res.write(), 
+ * req.body().read() or sleepFor() and finishes with 
+ * co_return HttpRouteHandling::End (or Continue). While it is suspended, no thread
+ * is blocked. It is resumed on the IoLoop thread.
+ *
+ * The frames are allocated from the FramePool.
+ */
+class HttpTask
+{
+public:
+
+    /**
+     * @brief Called with the result once the coroutine has finished.
+     */
+    typedef InplaceFunction<void (HttpRouteHandling handling), 48> Completion;
+
+    struct promise_type;
+
+    typedef std::coroutine_handle<promise_type> Handle;
+
+    /**
+     * @brief Calls the completion and frees the frame when the coroutine finishes.
+     */
+    struct FinalAwaiter
+    {
+        bool await_ready() noexcept { return false; }
+
+        void await_suspend(Handle h) noexcept;
+
+        void await_resume() noexcept { }
+    };
+
+    struct promise_type
+    {
+        HttpRouteHandling handling;
+
+        std::exception_ptr exception;
+
+        Completion completion;
+
+        HttpTask get_return_object()
+        {
+            return HttpTask(Handle::from_promise(*this));
+        }
+
+        /**
+         * @brief The coroutine doesn't run before start() was called, so the 
+         * completion is always set before the coroutine can finish.
+         */
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        FinalAwaiter final_suspend() noexcept { return {}; }
+
+        void return_value(HttpRouteHandling _handling) { handling = _handling; }
+
+        void unhandled_exception() { exception = std::current_exception(); }
+
+        static void * operator new(size_t size)
+        {
+            return FramePool::allocate(size);
+        }
+
+        static void operator delete(void *frame, size_t size)
+        {
+            FramePool::deallocate(frame, size);
+        }
+    };
+
+private:
+
+    Handle handle;
+
+public:
+
+    explicit HttpTask(Handle handle)
+        : handle{handle}
+    { }
+
+    HttpTask(HttpTask &&other)
+        : handle{std::exchange(other.handle, nullptr)}
+    { }
+
+    HttpTask & operator=(HttpTask &&other)
+    {
+        if (&other != this)
+        {
+            if (handle) handle.destroy();
+            handle = std::exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+
+    HttpTask(const HttpTask &other) = delete;
+
+    HttpTask & operator=(const HttpTask &other) = delete;
+
+    /**
+     * @brief Destroys the coroutine if it was never started.
+     */
+    ~HttpTask()
+    {
+        if (handle) handle.destroy();
+    }
+
+    /**
+     * @brief Run the coroutine on the calling thread until it finishes or is 
+     * suspended for the first time.
+     * 
+     * The completion is called on the thread that finishes the coroutine, which 
+     * is either the calling thread (before start returns) or the IoLoop thread. 
+     * If the coroutine exits with an exception, the exception is logged and the 
+     * completion is destroyed without being called.
+     */
+    void start(Completion &&completion)
+    {
+        Handle h = std::exchange(handle, nullptr);
+        h.promise().completion = std::move(completion);
+        h.resume();
+    }
+
+};
+
+#endif // _HTTP_TASK_HPP
@@ -1,10 +1,15 @@
 #ifndef _HTTPD_HPP
 #define _HTTPD_HPP
 
+#include <cstddef>
 #include <regex>
 #include <string>
 #include <unordered_map>
 #include <functional>
+#include <memory>
+#include <memory_resource>
+#include <atomic>
+#include <chrono>
 
 #include <netinet/in.h>
 
@@ -12,20 +17,70 @@
 #include "http_request.hpp"
 #include "http_response.hpp"
 #include "http_route.hpp"
+#include "http_middleware.hpp"
+#include "access_log.hpp"
 
 #include "threadpool.hpp"
 
 class HttpServer
 {
+public:
+
+    /**
+     * @brief Where the worker threads of the server are placed on the cpus.
+     */
+    enum class WorkerPlacement
+    {
+        /**
+         * @brief The workers are not pinned and the scheduler of the os decides.
+         */
+        Unpinned,
+        /**
+         * @brief Every worker is pinned to its own physical core, so no two 
+         * workers share a core through SMT.
+         */
+        PhysicalCores,
+        /**
+         * @brief One threadpool per NUMA node, with the workers pinned to the cpus 
+         * of their node. Connections are handled by the pool of the node whose 
+         * cpu received the connection (SO_INCOMING_CPU), so the socket data and 
+         * the buffers allocated by the worker stay on that node.
+         */
+        NumaNodes
+    };
+
 private:
 
+    /**
+     * @brief The smallest size of the read buffer for the head of a request.
+     */
     ssize_t tcp_read_buffer_size = 4096;
 
+    /**
+     * @brief The largest size the read buffer grows to for large heads.
+     */
+    static const size_t MAX_READ_BUFFER_SIZE = 65536;
+
+    /**
+     * @brief The read buffer size new connections start with. It grows when 
+     * clients send heads that need more than one read and slowly shrinks back to 
+     * tcp_read_buffer_size when they don't.
+     */
+    std::atomic<size_t> readBufferSize{4096};
+
     int pendingConnections = 5;
     int queuedConnections = 5;
 
     int numberOfThreads = Threadpool::AUTO_NO_WORKERS;
 
+    Threadpool::Scheduling scheduling = Threadpool::Scheduling::Fifo;
+
+    WorkerPlacement workerPlacement = WorkerPlacement::Unpinned;
+
+    bool elasticWorkers = false;
+
+    Threadpool::ElasticLimits elasticLimits{1, 1};
+
     std::string ip;
 
     in_addr ip_inaddr;
@@ -34,12 +89,135 @@ private:
 
     std::vector<HttpRoute> routes;
 
+    std::vector<HttpBeforeHook> beforeHooks;
+
+    std::vector<HttpAfterHook> afterHooks;
+
     static HttpRouteHandling defaultHandlerFunction(const HttpRequest &req, HttpResponse & res);
 
     HttpHandlerFn defaultHandler = &defaultHandlerFunction;
 
+    std::shared_ptr<AccessLog> accessLog;
+
+    /**
+     * @brief The server workers. Route matching that continues after a coroutine 
+     * handler finished on the IoLoop thread is handed back to them.
+     */
+    Threadpool *workerPool = nullptr;
+
+    /**
+     * @brief The state of a connection while its request is handled. The state 
+     * moves with the request when a route hands it over to an executor. The 
+     * socket is closed when the state is destroyed.
+     * 
+     * The memory of connections is pooled. Freed connections go to a free list 
+     * of the freeing thread, and to a shared list when that one is full, so 
+     * threads that only finish connections (executors, the IoLoop) hand their 
+     * memory back to the workers that accept them. Every NUMA node has its own 
+     * shared list and memory only goes back to the node it was allocated on, so 
+     * the node-local workers keep using node-local memory.
+     * 
+     * The arena buffer is part of that memory, so a steady server reuses the same 
+     * blocks instead of fragmenting the heap. Arena blocks beyond the inline 
+     * buffer, which only oversized requests need, are returned to the heap with 
+     * the connection.
+     */
+    struct Connection
+    {
+        /**
+         * @brief Size of the inline arena buffer. This fits the read buffer, the 
+         * head and the headers of a typical request without touching malloc.
+         */
+        static const size_t ARENA_BUFFER_SIZE = 16384;
+
+        int sockfd;
+
+        /**
+         * @brief Storage for the first arena block, allocated together with the
+         * connection.
+         */
+        alignas(std::max_align_t) std::byte arenaBuffer[ARENA_BUFFER_SIZE];
+
+        /**
+         * @brief Monotonic arena for everything that lives as long as the request:
+         * read buffers, head, headers and the response head. It is released at 
+         * once when the connection is destroyed. Only one thread works on a 
+         * connection at a time, so it needs no locking.
+         */
+        std::pmr::monotonic_buffer_resource arena;
+
+        HttpRequest req;
+
+        HttpResponse res;
+
+        /**
+         * @brief Start of the request handling, used for the latency.
+         */
+        std::chrono::steady_clock::time_point start;
+
+        Connection(int sockfd);
+
+        ~Connection();
+
+        static void * operator new(size_t size);
+
+        static void operator delete(void *memory);
+    };
+
+    /**
+     * @brief Update readBufferSize with the size of a head that was just read.
+     */
+    void adaptReadBufferSize(size_t headSize);
+
     void handleConnection(int sockfd, const std::string &ip, uint16_t port);
 
+    /**
+     * @brief Match the routes starting at firstRoute. If a matching route is bound 
+     * to an executor other than the current one, the connection is handed over 
+     * to that executor and the matching continues there.
+     * 
+     * @param current The executor the function runs on, or nullptr for the server 
+     *  workers.
+     */
+    void routeConnection(std::unique_ptr<Connection> conn, size_t firstRoute, HttpExecutor *current);
+
+    /**
+     * @brief Same as routeConnection(), but logs exceptions instead of throwing. 
+     * Used where the routing was handed over to another thread.
+     */
+    void resumeRouting(std::unique_ptr<Connection> conn, size_t firstRoute, HttpExecutor *current);
+
+    /**
+     * @brief Continue after the coroutine handler of the route has finished.
+     */
+    void continueAfterTask(std::unique_ptr<Connection> conn, size_t route, HttpExecutor *current, 
+        HttpRouteHandling handling);
+
+    /**
+     * @brief Run the default handler if the request wasn't handled yet, then the 
+     * after hooks and the access log.
+     */
+    void finishConnection(Connection &conn, bool finalHandled);
+
+    /**
+     * @brief Create the worker threadpools according to the worker placement.
+     * 
+     * @param pools Receives the created threadpools.
+     * 
+     * @param poolOfCpu Receives the index of the pool for every logical cpu. Only 
+     *  filled if there is more than one pool.
+     */
+    void createThreadpools(std::vector<std::unique_ptr<Threadpool>> &pools, std::vector<int> &poolOfCpu);
+
+    /**
+     * @brief Create and pin the threadpools for the worker placement, used by 
+     * createThreadpools().
+     */
+    void createThreadpoolsPlaced(std::vector<std::unique_ptr<Threadpool>> &pools, std::vector<int> &poolOfCpu);
+
+    void logAccess(const HttpRequest &req, uint16_t status, size_t bytesSent,
+        std::chrono::steady_clock::time_point start);
+
 public:
 
     HttpServer(uint16_t port, std::string ip = "0.0.0.0");
@@ -49,8 +227,42 @@ public:
         routes.push_back(route);
     }
 
+    /**
+     * @brief Add a middleware to the server. The before hooks are called in the
+     * order they were added, before any route is matched. The after hooks are
+     * called in the same order once the response was sent.
+     */
+    void addMiddleware(HttpMiddleware middleware);
+
     void setDefaultHandler(const HttpHandlerFn &);
 
+    /**
+     * @brief Set the scheduling strategy of the worker threadpool. Must be called
+     * before serveForever().
+     */
+    void setScheduling(Threadpool::Scheduling scheduling);
+
+    /**
+     * @brief Set how the worker threads are placed on the cpus. Must be called 
+     * before serveForever().
+     */
+    void setWorkerPlacement(WorkerPlacement placement);
+
+    /**
+     * @brief Let the worker threadpools grow and shrink between the limits 
+     * depending on the queueing delay of connections. Requires fifo scheduling.
+     * Must be called before serveForever().
+     * 
+     * @see Threadpool::enableElasticSizing
+     */
+    void setElasticWorkers(const Threadpool::ElasticLimits &limits);
+
+    /**
+     * @brief Log every handled request to the given access log. Pass nullptr to
+     * disable access logging.
+     */
+    void setAccessLog(std::shared_ptr<AccessLog> log);
+
     void serveForever();
 
 };
@@ -0,0 +1,157 @@
+#ifndef _INPLACE_FUNCTION_HPP
+#define _INPLACE_FUNCTION_HPP
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+template <typename Signature, size_t Capacity = 64>
+class InplaceFunction;
+
+/**
+ * @brief A move-only replacement for std::function that stores the callable in
+ * a fixed size inline buffer and never allocates.
+ *
+ * Callables that don't fit into the buffer are rejected at compile time instead
+ * of falling back to the heap. Because the callable is never copied, move-only
+ * captures (e.g. std::unique_ptr) are supported.
+ *
+ * @tparam R The return type of the function.
+ * @tparam Args The argument types of the function.
+ * @tparam Capacity The size of the inline buffer in bytes.
+ */
+template <typename R, typename... Args, size_t Capacity>
+class InplaceFunction<R (Args...), Capacity>
+{
+private:
+
+    /**
+     * @brief Type erased operations for the stored callable.
+     */
+    struct Operations
+    {
+        R (*invoke)(void *callable, Args&&... args);
+        void (*move)(void *dst, void *src);
+        void (*destroy)(void *callable);
+    };
+
+    template <typename Fn>
+    static R invokeCallable(void *callable, Args&&... args)
+    {
+        return (*static_cast<Fn*>(callable))(std::forward<Args>(args)...);
+    }
+
+    template <typename Fn>
+    static void moveCallable(void *dst, void *src)
+    {
+        new (dst) Fn(std::move(*static_cast<Fn*>(src)));
+        static_cast<Fn*>(src)->~Fn();
+    }
+
+    template <typename Fn>
+    static void destroyCallable(void *callable)
+    {
+        static_cast<Fn*>(callable)->~Fn();
+    }
+
+    template <typename Fn>
+    static constexpr Operations operationsFor = {
+        &invokeCallable<Fn>, &moveCallable<Fn>, &destroyCallable<Fn>
+    };
+
+    alignas(std::max_align_t) mutable unsigned char storage[Capacity];
+
+    const Operations *operations = nullptr;
+
+public:
+
+    /**
+     * @brief The size of the inline buffer in bytes.
+     */
+    static constexpr size_t capacity = Capacity;
+
+    InplaceFunction() noexcept = default;
+
+    InplaceFunction(std::nullptr_t) noexcept
+    { }
+
+    /**
+     * @brief Store the callable in the inline buffer.
+     */
+    template <typename F, typename Fn = std::decay_t<F>,
+        typename = std::enable_if_t<!std::is_same<Fn, InplaceFunction>::value>>
+    InplaceFunction(F &&f)
+    {
+        static_assert(sizeof(Fn) <= Capacity,
+            "Callable is too large for the InplaceFunction buffer");
+        static_assert(alignof(Fn) <= alignof(std::max_align_t),
+            "Callable is over-aligned for the InplaceFunction buffer");
+
+        new (storage) Fn(std::forward<F>(f));
+        operations = &operationsFor<Fn>;
+    }
+
+    InplaceFunction(InplaceFunction &&other) noexcept
+        : operations{other.operations}
+    {
+        if (operations)
+        {
+            operations->move(storage, other.storage);
+            other.operations = nullptr;
+        }
+    }
+
+    InplaceFunction & operator=(InplaceFunction &&other) noexcept
+    {
+        if (&other != this)
+        {
+            reset();
+
+            if (other.operations)
+            {
+                other.operations->move(storage, other.storage);
+                operations = other.operations;
+                other.operations = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    InplaceFunction(const InplaceFunction &other) = delete;
+
+    InplaceFunction & operator=(const InplaceFunction &other) = delete;
+
+    ~InplaceFunction()
+    {
+        reset();
+    }
+
+    /**
+     * @brief Destroy the stored callable, leaving the function empty.
+     */
+    void reset() noexcept
+    {
+        if (operations)
+        {
+            operations->destroy(storage);
+            operations = nullptr;
+        }
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return operations != nullptr;
+    }
+
+    /**
+     * @brief Call the stored callable. Calling an empty function is undefined.
+     */
+    R operator()(Args... args) const
+    {
+        return operations->invoke(storage, std::forward<Args>(args)...);
+    }
+
+};
+
+#endif // _INPLACE_FUNCTION_HPP
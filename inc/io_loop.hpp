@@ -0,0 +1,142 @@
+#ifndef _IO_LOOP_HPP
+#define _IO_LOOP_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Something that waits for the IoLoop, usually the awaiter of a suspended
+ * coroutine.
+ */
+class IoWaiter
+{
+public:
+
+    /**
+     * @brief Called on the loop thread once the awaited event happened.
+     */
+    virtual void onReady() = 0;
+
+protected:
+
+    ~IoWaiter() = default;
+
+};
+
+/**
+ * @brief Event loop that drives the coroutine handlers.
+ *
+ * The loop thread waits on an epoll instance for file descriptors to become
+ * readable or writable, and on a timer heap for deadlines. When an event happens,
+ * the waiter is called on the loop thread, which usually resumes the suspended
+ * coroutine. Coroutines therefore run on the loop thread between two suspension
+ * points and must not block there.
+ *
+ * Every registration fires exactly once.
+ */
+class IoLoop
+{
+private:
+
+    struct Timer
+    {
+        std::chrono::steady_clock::time_point deadline;
+
+        IoWaiter *waiter;
+
+        bool operator>(const Timer &other) const
+        {
+            return deadline > other.deadline;
+        }
+    };
+
+    /**
+     * @brief The epoll instance for the file descriptor waits.
+     */
+    int epollFd;
+
+    /**
+     * @brief Eventfd to wake up the loop thread, e.g. when an earlier timer was 
+     * added or the loop is stopped.
+     */
+    int wakeFd;
+
+    /**
+     * @brief Min-heap of the pending timers.
+     * 
+     * NOTE: The access is not synchronized by default and the mtxTimers mutex must 
+     * be used to access this variable.
+     */
+    std::vector<Timer> timers;
+
+    std::mutex mtxTimers;
+
+    std::atomic<bool> stopped{false};
+
+    std::thread loopThread;
+
+    void run();
+
+    /**
+     * @brief Pop and call the waiters of all timers that have expired.
+     * 
+     * @return The time until the next timer expires in ms, or -1 if there is none.
+     */
+    int runExpiredTimers();
+
+    void wakeUp();
+
+public:
+
+    /**
+     * @brief Create the epoll instance and start the loop thread.
+     */
+    IoLoop();
+
+    IoLoop(const IoLoop &other) = delete;
+
+    IoLoop & operator=(const IoLoop &other) = delete;
+
+    /**
+     * @brief Stop and join the loop thread. Pending waiters are not called.
+     */
+    ~IoLoop();
+
+    /**
+     * @brief The loop used by the coroutine handlers. It is started on first use.
+     */
+    static IoLoop & getDefault();
+
+    /**
+     * @brief Call the waiter once the file descriptor is ready for the events.
+     * 
+     * @param fd The file descriptor. Only one wait per file descriptor may be 
+     *  pending at a time.
+     * 
+     * @param events The epoll events to wait for, e.g. EPOLLIN or EPOLLOUT.
+     * 
+     * @param waiter Called on the loop thread. Can already be called before this
+     *  function returns.
+     */
+    void waitFd(int fd, uint32_t events, IoWaiter *waiter);
+
+    /**
+     * @brief Call the waiter once the deadline has passed.
+     * 
+     * @param waiter Called on the loop thread. Can already be called before this
+     *  function returns.
+     */
+    void waitUntil(std::chrono::steady_clock::time_point deadline, IoWaiter *waiter);
+
+    /**
+     * @brief Check if the calling thread is the loop thread.
+     */
+    bool isLoopThread() const;
+
+};
+
+#endif // _IO_LOOP_HPP
@@ -0,0 +1,86 @@
+#ifndef _MAPPED_FILE_HPP
+#define _MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <sys/stat.h>
+
+/**
+ * @brief A file that is mapped read-only into memory.
+ *
+ * The content is served directly from the kernel page cache. Nothing is copied
+ * into the heap, all processes that map the same file share the pages, and 
+ * mapping is cheap because no data is read until it is accessed.
+ *
+ * The file is mapped with MAP_PRIVATE, so the mapping keeps working when the file
+ * is deleted or replaced by a rename. A file that is truncated or rewritten in
+ * place while it is mapped can still change the content or fault on access, so
+ * deployments must replace files by a rename. isUnchanged() detects in-place
+ * changes before a response starts, but not while it is being sent.
+ */
+class MappedFile
+{
+private:
+
+    uint8_t *mapping = nullptr;
+
+    size_t length = 0;
+
+    /**
+     * @brief A descriptor of the mapped file, to check it for in-place changes.
+     */
+    int fd = -1;
+
+    /**
+     * @brief The metadata of the file when it was mapped.
+     */
+    struct stat st = {};
+
+    MappedFile() = default;
+
+public:
+
+    /**
+     * @brief Files of at least this size are advised to use transparent huge 
+     * pages, where the kernel supports them for file mappings.
+     */
+    static const size_t HUGEPAGE_THRESHOLD = 2 * 1024 * 1024;
+
+    /**
+     * @brief Map the file and advise the kernel to read it ahead (MADV_WILLNEED).
+     * 
+     * @return The mapped file or nullptr if the path isn't a readable regular file.
+     */
+    static std::shared_ptr<const MappedFile> open(const std::string &path);
+
+    /**
+     * @brief Map a file that is already open. The descriptor is not closed.
+     * 
+     * @param st The metadata of the open file.
+     */
+    static std::shared_ptr<const MappedFile> fromDescriptor(int fd, const struct stat &st);
+
+    MappedFile(const MappedFile &other) = delete;
+
+    MappedFile & operator=(const MappedFile &other) = delete;
+
+    ~MappedFile();
+
+    const uint8_t * data() const;
+
+    size_t size() const;
+
+    /**
+     * @brief Check that the mapped file still has the size and modification time
+     * it had when it was mapped. Costs one fstat().
+     * 
+     * @return False if the file was truncated or rewritten in place.
+     */
+    bool isUnchanged() const;
+
+};
+
+#endif // _MAPPED_FILE_HPP
@@ -0,0 +1,14 @@
+#ifndef _MIME_TYPES_HPP
+#define _MIME_TYPES_HPP
+
+#include <string_view>
+
+/**
+ * @brief Get the MIME type for a file by the extension of its path. The lookup is
+ * case insensitive. Text types include the utf-8 charset.
+ *
+ * @return The MIME type, or "application/octet-stream" for unknown extensions.
+ */
+std::string_view mimeTypeForPath(std::string_view path);
+
+#endif // _MIME_TYPES_HPP
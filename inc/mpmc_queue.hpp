@@ -0,0 +1,316 @@
+#ifndef _MPMC_QUEUE_HPP
+#define _MPMC_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+/**
+ * @brief Bounded lock-free multi-producer multi-consumer fifo queue.
+ *
+ * This is the array based queue by Dmitry Vyukov. Every cell has a sequence number
+ * that tells producers and consumers whether the cell is free to be written or
+ * ready to be read. Producers and consumers only contend on their own position
+ * counter with a single CAS, there is no lock and no shared size counter.
+ *
+ * For position pos, the sequence of the cell is 2 * pos while the cell is free
+ * and 2 * pos + 1 once it was written. Using two steps per position keeps the
+ * states apart even for a capacity of 1.
+ *
+ * The queue never blocks. Blocking when the queue is empty or full is left to
+ * the user (see EventCount).
+ *
+ * @tparam T The item type. Must be default constructible and move assignable.
+ */
+template <typename T>
+class MpmcQueue
+{
+private:
+
+    struct alignas(64) Cell
+    {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    /**
+     * @brief The number of cells in the ring.
+     */
+    size_t _capacity;
+
+    std::unique_ptr<Cell[]> cells;
+
+    /**
+     * @brief Position of the next push. Each position counter is on its own cache
+     * line, so producers and consumers don't slow each other down.
+     */
+    alignas(64) std::atomic<size_t> enqueuePos{0};
+
+    /**
+     * @brief Position of the next pop.
+     */
+    alignas(64) std::atomic<size_t> dequeuePos{0};
+
+    /**
+     * @brief Reserve the cell for the next push.
+     *
+     * @return The reserved cell, or nullptr if the queue is full.
+     */
+    Cell * reservePush(size_t &pos)
+    {
+        pos = enqueuePos.load(std::memory_order_relaxed);
+
+        while (true)
+        {
+            Cell *cell = &cells[pos % _capacity];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(2 * pos);
+
+            if (diff == 0)
+            {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    return cell;
+            }
+            else if (diff < 0)
+            {
+                // The cell still holds an item from the previous round
+                return nullptr;
+            }
+            else
+            {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+public:
+
+    /**
+     * @param capacity The maximum number of items in the queue. Must be at least 1.
+     */
+    explicit MpmcQueue(size_t capacity)
+        : _capacity{capacity}
+    {
+        if (capacity < 1)
+        {
+            throw std::runtime_error("MpmcQueue capacity must be at least 1");
+        }
+
+        cells.reset(new Cell[capacity]);
+
+        for (size_t i = 0; i < capacity; i++)
+        {
+            cells[i].sequence.store(2 * i, std::memory_order_relaxed);
+        }
+    }
+
+    MpmcQueue(const MpmcQueue &other) = delete;
+
+    MpmcQueue & operator=(const MpmcQueue &other) = delete;
+
+    /**
+     * @brief Add an item to the end of the queue if there is space.
+     *
+     * @param value The item to add. It is only moved from if the push succeeds.
+     *
+     * @return True if the item was added, false if the queue is full.
+     */
+    bool tryPush(T &&value)
+    {
+        size_t pos;
+        Cell *cell = reservePush(pos);
+
+        if (!cell) return false;
+
+        cell->value = std::move(value);
+        cell->sequence.store(2 * pos + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    /**
+     * @brief Copying version of tryPush(T&&).
+     */
+    bool tryPush(const T &value)
+    {
+        size_t pos;
+        Cell *cell = reservePush(pos);
+
+        if (!cell) return false;
+
+        cell->value = value;
+        cell->sequence.store(2 * pos + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    /**
+     * @brief Take the item from the front of the queue if there is one.
+     *
+     * @param value Receives the item.
+     *
+     * @return True if an item was taken, false if the queue is empty.
+     */
+    bool tryPop(T &value)
+    {
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        Cell *cell;
+
+        while (true)
+        {
+            cell = &cells[pos % _capacity];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(2 * pos + 1);
+
+            if (diff == 0)
+            {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                // The cell wasn't written yet
+                return false;
+            }
+            else
+            {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        value = std::move(cell->value);
+        cell->sequence.store(2 * (pos + _capacity), std::memory_order_release);
+
+        return true;
+    }
+
+    /**
+     * @brief Add up to count items to the end of the queue with a single CAS.
+     *
+     * The cells for a batch are reserved together. This is safe because a cell 
+     * that is free for position pos can only be taken by the producer that 
+     * claims pos, which requires moving enqueuePos past it.
+     *
+     * @param items The items to add. Only the added items are moved from.
+     *
+     * @return The number of items that were added, which is less than count if 
+     *  the queue doesn't have enough space.
+     */
+    size_t tryPushBulk(T *items, size_t count)
+    {
+        if (count == 0) return 0;
+
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        size_t n;
+
+        while (true)
+        {
+            // Count the free cells from pos on
+            n = 0;
+            while (n < count && n < _capacity 
+                && cells[(pos + n) % _capacity].sequence.load(std::memory_order_acquire) == 2 * (pos + n))
+            {
+                n++;
+            }
+
+            if (n == 0)
+            {
+                size_t seq = cells[pos % _capacity].sequence.load(std::memory_order_acquire);
+
+                // The first cell still holds an item from the previous round
+                if ((intptr_t)seq - (intptr_t)(2 * pos) < 0)
+                    return 0;
+
+                pos = enqueuePos.load(std::memory_order_relaxed);
+                continue;
+            }
+
+            if (enqueuePos.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed))
+                break;
+        }
+
+        for (size_t i = 0; i < n; i++)
+        {
+            Cell &cell = cells[(pos + i) % _capacity];
+            cell.value = std::move(items[i]);
+            cell.sequence.store(2 * (pos + i) + 1, std::memory_order_release);
+        }
+
+        return n;
+    }
+
+    /**
+     * @brief Take up to max items from the front of the queue with a single CAS.
+     *
+     * @param items Receives the items.
+     *
+     * @return The number of items taken, 0 if the queue is empty.
+     */
+    size_t tryPopBulk(T *items, size_t max)
+    {
+        if (max == 0) return 0;
+
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        size_t n;
+
+        while (true)
+        {
+            // Count the written cells from pos on
+            n = 0;
+            while (n < max && n < _capacity 
+                && cells[(pos + n) % _capacity].sequence.load(std::memory_order_acquire) == 2 * (pos + n) + 1)
+            {
+                n++;
+            }
+
+            if (n == 0)
+            {
+                size_t seq = cells[pos % _capacity].sequence.load(std::memory_order_acquire);
+
+                // The first cell wasn't written yet
+                if ((intptr_t)seq - (intptr_t)(2 * pos + 1) < 0)
+                    return 0;
+
+                pos = dequeuePos.load(std::memory_order_relaxed);
+                continue;
+            }
+
+            if (dequeuePos.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed))
+                break;
+        }
+
+        for (size_t i = 0; i < n; i++)
+        {
+            Cell &cell = cells[(pos + i) % _capacity];
+            items[i] = std::move(cell.value);
+            cell.sequence.store(2 * (pos + i + _capacity), std::memory_order_release);
+        }
+
+        return n;
+    }
+
+    /**
+     * @brief The maximum number of items in the queue.
+     */
+    size_t capacity() const
+    {
+        return _capacity;
+    }
+
+    /**
+     * @brief Get the number of items in the queue. The result may already be
+     * outdated when other threads access the queue concurrently.
+     */
+    size_t sizeApprox() const
+    {
+        size_t enq = enqueuePos.load(std::memory_order_relaxed);
+        size_t deq = dequeuePos.load(std::memory_order_relaxed);
+        return enq > deq ? enq - deq : 0;
+    }
+
+};
+
+#endif // _MPMC_QUEUE_HPP
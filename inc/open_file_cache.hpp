@@ -0,0 +1,179 @@
+#ifndef _OPEN_FILE_CACHE_HPP
+#define _OPEN_FILE_CACHE_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <sys/stat.h>
+
+/**
+ * @brief An open, read-only regular file with the metadata from when it was
+ * opened. The descriptor is closed when the last reference is released.
+ *
+ * The descriptor is shared by all workers that serve the file, so it must only
+ * be read with pread(). The file position is never used.
+ */
+class OpenFile
+{
+private:
+
+    int fd;
+
+    struct stat st;
+
+    std::string tag;
+
+public:
+
+    /**
+     * @brief Take over the open descriptor of a regular file.
+     */
+    OpenFile(int fd, const struct stat &st);
+
+    OpenFile(const OpenFile &other) = delete;
+
+    OpenFile & operator=(const OpenFile &other) = delete;
+
+    ~OpenFile();
+
+    int descriptor() const;
+
+    size_t size() const;
+
+    const struct timespec & modified() const;
+
+    const std::string & etag() const;
+
+    /**
+     * @brief Check if the path still refers to the same, unmodified file.
+     */
+    bool isSameFile(const struct stat &current) const;
+
+};
+
+/**
+ * @brief A cache of open file descriptors and their metadata, keyed by path,
+ * like the open_file_cache of nginx.
+ *
+ * Serving a hot file from the cache needs neither open() nor stat(), only the
+ * reads of the content. Files that don't exist are cached as well (negative
+ * lookups), so requests for missing files don't hit the filesystem either.
+ *
+ * Entries are valid for the ttl. An expired entry is checked with a single
+ * stat(), and the open descriptor is kept if the file is unchanged. Callers that
+ * know a path changed can erase() it earlier. The number of entries is limited,
+ * the least recently used entries of a shard are closed first. Descriptors that
+ * are still used by a response stay open until the response is done.
+ */
+class OpenFileCache
+{
+public:
+
+    typedef std::chrono::steady_clock Clock;
+
+    /**
+     * @brief The number of independently locked shards.
+     */
+    static const size_t NUMBER_OF_SHARDS = 16;
+
+    static const size_t DEFAULT_MAX_ENTRIES = 1024;
+
+    static constexpr std::chrono::milliseconds DEFAULT_TTL = std::chrono::seconds(60);
+
+private:
+
+    struct Entry
+    {
+        std::string path;
+
+        /**
+         * @brief The open file, or nullptr if the path is not a readable regular
+         * file (negative lookup).
+         */
+        std::shared_ptr<const OpenFile> file;
+
+        Clock::time_point expires;
+    };
+
+    typedef std::list<Entry> LruList;
+
+    struct Shard
+    {
+        std::mutex mtx;
+
+        /**
+         * @brief The entries, most recently used first.
+         */
+        LruList lru;
+
+        /**
+         * @brief The keys view the paths stored in the list nodes, which never move.
+         */
+        std::unordered_map<std::string_view, LruList::iterator> index;
+    };
+
+    Shard shards[NUMBER_OF_SHARDS];
+
+    size_t shardCapacity;
+
+    Clock::duration ttl;
+
+    Shard & shardOf(std::string_view path);
+
+    /**
+     * @brief Insert or replace the entry for the path, evicting the least recently
+     * used entries of the shard until it fits.
+     */
+    void put(const std::string &path, std::shared_ptr<const OpenFile> file, Clock::time_point now);
+
+public:
+
+    /**
+     * @param maxEntries The total number of paths the cache may hold, including
+     * negative lookups.
+     *
+     * @param ttl How long an entry is used without checking the file again.
+     */
+    OpenFileCache(size_t maxEntries = DEFAULT_MAX_ENTRIES, Clock::duration ttl = DEFAULT_TTL);
+
+    OpenFileCache(const OpenFileCache &other) = delete;
+
+    OpenFileCache & operator=(const OpenFileCache &other) = delete;
+
+    /**
+     * @brief The cache shared by the file routes.
+     */
+    static OpenFileCache & getDefault();
+
+    /**
+     * @brief Get the open file for the path, opening it if it is not cached or
+     * has changed.
+     *
+     * @return The file or nullptr if the path is not a readable regular file.
+     */
+    std::shared_ptr<const OpenFile> open(const std::string &path);
+
+    /**
+     * @brief Remove the path from the cache, so the next open() looks it up again.
+     */
+    void erase(std::string_view path);
+
+    /**
+     * @brief Remove all paths from the cache.
+     */
+    void clear();
+
+    /**
+     * @brief The number of cached paths, including negative lookups.
+     */
+    size_t getEntryCount();
+
+};
+
+#endif // _OPEN_FILE_CACHE_HPP
@@ -0,0 +1,247 @@
+#ifndef _RESPONSE_CACHE_HPP
+#define _RESPONSE_CACHE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "http_route.hpp"
+
+/**
+ * @brief A complete response as it was sent to the socket, head and body, with
+ * the time it may be replayed.
+ */
+class CachedResponse
+{
+public:
+
+    typedef std::chrono::steady_clock Clock;
+
+private:
+
+    std::string bytes;
+
+    uint16_t status;
+
+    Clock::time_point freshUntil;
+
+    Clock::time_point staleUntil;
+
+    mutable std::atomic<bool> revalidating{false};
+
+public:
+
+    CachedResponse(std::string &&bytes, uint16_t status, Clock::time_point freshUntil,
+        Clock::time_point staleUntil);
+
+    const std::string & data() const;
+
+    uint16_t getStatus() const;
+
+    bool isFresh(Clock::time_point now) const;
+
+    /**
+     * @brief Check if the response may still be sent while it is being refreshed.
+     */
+    bool isUsableStale(Clock::time_point now) const;
+
+    /**
+     * @brief Claim the refresh of a stale response. Only the first caller gets
+     * true, until endRevalidate() is called.
+     */
+    bool beginRevalidate() const;
+
+    /**
+     * @brief Give up the refresh, e.g. when the new response was not cacheable, so
+     * another request can try.
+     */
+    void endRevalidate() const;
+
+};
+
+/**
+ * @brief A byte budgeted in-memory cache for serialized responses, keyed by the
+ * request.
+ *
+ * Like FileCache, the cache is split into NUMBER_OF_SHARDS independently locked
+ * shards, each with an equal part of the byte budget and size aware LRU
+ * eviction. Expired responses are dropped when they are looked up.
+ */
+class ResponseCache
+{
+public:
+
+    /**
+     * @brief The number of independently locked shards.
+     */
+    static const size_t NUMBER_OF_SHARDS = 16;
+
+private:
+
+    typedef std::list<std::pair<std::string, std::shared_ptr<const CachedResponse>>> LruList;
+
+    struct Shard
+    {
+        std::mutex mtx;
+
+        /**
+         * @brief The entries, most recently used first.
+         */
+        LruList lru;
+
+        /**
+         * @brief The keys view the keys stored in the list nodes, which never move.
+         */
+        std::unordered_map<std::string_view, LruList::iterator> index;
+
+        size_t bytes = 0;
+    };
+
+    Shard shards[NUMBER_OF_SHARDS];
+
+    size_t shardCapacity;
+
+    size_t maxResponseSize;
+
+    Shard & shardOf(std::string_view key);
+
+    static size_t entrySize(const LruList::value_type &entry);
+
+public:
+
+    /**
+     * @param capacityBytes The total number of key and response bytes the cache
+     * may hold.
+     *
+     * @param maxResponseSize The largest response that is admitted to the cache.
+     */
+    ResponseCache(size_t capacityBytes, size_t maxResponseSize);
+
+    ResponseCache(const ResponseCache &other) = delete;
+
+    ResponseCache & operator=(const ResponseCache &other) = delete;
+
+    /**
+     * @brief Get the response for the key and mark it as recently used. Responses
+     * that are neither fresh nor usable stale are removed.
+     *
+     * @return The response or nullptr if there is none.
+     */
+    std::shared_ptr<const CachedResponse> get(std::string_view key, CachedResponse::Clock::time_point now);
+
+    /**
+     * @brief Insert or replace the response for the key, evicting the least
+     * recently used responses of its shard until it fits.
+     *
+     * @return True if the response was cached, false if it is too large.
+     */
+    bool put(std::string_view key, std::shared_ptr<const CachedResponse> response);
+
+    /**
+     * @brief Remove all responses from the cache.
+     */
+    void clear();
+
+    /**
+     * @brief The number of key and response bytes currently cached.
+     */
+    size_t getCachedBytes();
+
+};
+
+/**
+ * @brief Options for cacheResponses().
+ */
+struct ResponseCacheOptions
+{
+    /**
+     * @brief How long a response is replayed, unless the response sets max-age or
+     * s-maxage in its Cache-Control header.
+     */
+    std::chrono::milliseconds ttl = std::chrono::seconds(1);
+
+    /**
+     * @brief How long an expired response may still be sent while one request
+     * runs the handler to refresh it, unless the response sets
+     * stale-while-revalidate in its Cache-Control header.
+     */
+    std::chrono::milliseconds staleWhileRevalidate = std::chrono::milliseconds(0);
+
+    /**
+     * @brief The number of key and response bytes kept in memory for the route.
+     */
+    size_t cacheBytes = 16 * 1024 * 1024;
+
+    /**
+     * @brief Larger responses are not cached.
+     */
+    size_t maxResponseSize = 1024 * 1024;
+
+    /**
+     * @brief The request headers that are part of the key besides the method and
+     * the URI, because the response depends on them (e.g. Accept-Encoding).
+     */
+    std::vector<std::string> varyHeaders;
+};
+
+/**
+ * @brief Cache the responses of the route's handler in memory for a short time
+ * (micro-caching), so an expensive handler runs once per TTL instead of once
+ * per request.
+ *
+ * Only GET and HEAD requests without an Authorization header are cached, keyed
+ * by the method, the URI and the values of the vary headers. A response is
+ * stored exactly as it was sent, when the handler ended the routing with a
+ * status of 200, 203, 204, 301, 404 or 410. Responses with Set-Cookie or with
+ * no-store, no-cache or private in their Cache-Control header are not stored.
+ *
+ * Only handlers that send with the blocking calls can be cached, coroutine
+ * handlers are rejected with std::runtime_error.
+ */
+HttpRoute cacheResponses(HttpRoute route, const ResponseCacheOptions &options = ResponseCacheOptions{});
+
+/**
+ * @brief Options for coalesceRequests().
+ */
+struct CoalescingOptions
+{
+    /**
+     * @brief See ResponseCacheOptions::varyHeaders.
+     */
+    std::vector<std::string> varyHeaders;
+};
+
+/**
+ * @brief Run the route's handler only once for concurrent identical requests
+ * (single-flight), to avoid a thundering herd when a popular, expensive URI is 
+ * requested by many clients at once.
+ *
+ * The first request runs the handler while the identical requests that arrive in
+ * the meantime wait for it, and then get the same response sent as it is.
+ * Requests are identical under the same rules as for cacheResponses(). Requests
+ * with a Cookie header are only coalesced if Cookie is one of the vary headers.
+ * If the handler throws, one of the waiting requests runs it again.
+ *
+ * The response is only shared if cacheResponses() could store it: a cacheable
+ * status, no Set-Cookie and no no-store, no-cache or private in Cache-Control.
+ * Otherwise the waiting requests run the handler themselves.
+ *
+ * The waiting requests block their worker threads, so a route that coalesces a 
+ * lot of requests should run on its own executor. Combined with 
+ * cacheResponses(), coalesceRequests() is the inner wrapper, so only cache 
+ * misses are coalesced.
+ *
+ * Coroutine handlers are rejected with std::runtime_error.
+ */
+HttpRoute coalesceRequests(HttpRoute route, const CoalescingOptions &options = CoalescingOptions{});
+
+#endif // _RESPONSE_CACHE_HPP
@@ -7,32 +7,54 @@
 #ifndef _CPPSEMAPHORE_HPP
 #define _CPPSEMAPHORE_HPP
 
-extern "C" {
-#include <semaphore.h>
-}
+#include <atomic>
+#include <cstdint>
 
 /**
- * @brief The Semaphore class provides a simple CPP wrapper for the sem_* 
- * functions from the C "semaphore.h" library. This only uses the thread-shared
- * semaphore, not process shared.
+ * @brief The Semaphore class provides a counting semaphore for threads of the
+ * same process. It is built directly on a futex: the counter is an atomic that
+ * is changed in user space, and the kernel is only entered to sleep when the
+ * counter is 0 or to wake up a thread that is actually sleeping.
+ * 
+ * Waiting spins for a short, bounded time before going to sleep, since under
+ * high task rates the counter is usually incremented again within a few hundred
+ * nanoseconds.
  */
 class Semaphore
 {
 private:
     /**
-     * @brief Pointer to the underlying C semaphore.
+     * @brief The semaphore counter. This is also the futex word that waiting
+     * threads sleep on.
+     */
+    std::atomic<uint32_t> _value;
+
+    /**
+     * @brief The number of threads that are sleeping (or about to sleep) on the
+     * futex. post() only makes the wake syscall if this is not 0.
+     */
+    std::atomic<uint32_t> _waiters{0};
+
+    /**
+     * @brief The number of times wait() checks the counter before going to sleep.
+     */
+    static const int SPIN_ITERATIONS = 128;
+
+    /**
+     * @brief Spin for a bounded time until the counter can be decremented. Does
+     * not spin on a single cpu.
+     * 
+     * @return True if the semaphore was decremented while spinning.
      */
-    sem_t * _semaphore;
+    bool spinWait();
 
 public:
 
     /**
      * @brief Initialize the Semaphore and set the start value.
      * 
-     * @param initialValue The Semaphore counter value to start with. 
+     * @param initialValue The Semaphore counter value to start with.
      *  0 by default.
-     * 
-     * @see sem_init
      */
     Semaphore(int initialValue = 0);
 
@@ -51,78 +73,74 @@ public:
     Semaphore & operator=(const Semaphore & other) = delete;
 
     /**
-     * @brief Create the instance by taking over an existing Semaphore.
+     * @brief Create the instance by taking over the counter value of an existing
+     * Semaphore.
      * 
-     * @warning The moved-from instance is no longer valid to use after the move.
+     * @warning No thread may wait on either semaphore during the move. The
+     * moved-from instance is left with the value 0.
      * 
      * @param other The reference to take over.
      */
     Semaphore(Semaphore && other);
 
     /**
-     * @brief Take over an existing Semaphore. The internal samaphore is destroyed 
-     * and replace by the internal semaphore of the other instance. 
+     * @brief Take over the counter value of an existing Semaphore.
      * 
-     * @warning The moved-from instance is no longer valid to use after the move.
+     * @warning No thread may wait on either semaphore during the move. The
+     * moved-from instance is left with the value 0.
      * 
      * @param other The reference to take over.
      */
     Semaphore & operator=(Semaphore && other);
-    
+
     /**
-     * @brief Destructor destroys the underlying semaphore and frees the memory.
-     * 
-     * @see sem_destroy
+     * @brief Destructor. No thread may be waiting on the semaphore anymore.
      */
-    ~Semaphore();
+    ~Semaphore() = default;
 
     /**
      * @brief Incremet the Semaphore.
      * 
-     * Increments the underlying semaphore using sem_post. If another thread is
-     * waiting, it will be woken up.
+     * Increments the counter. If another thread is sleeping in wait(), it will
+     * be woken up. If no thread is sleeping, no syscall is made.
      * 
-     * @see sem_post
+     * @see futex(2) FUTEX_WAKE
      */
     void post();
 
     /**
      * @brief Decrement the Semaphore or wait if 0.
      * 
-     * Decrements the underlying semaphore using sem_wait. If the semaphore has 
-     * the value 0, the function blocks until it can decrement (post was 
+     * Decrements the counter. If the counter has the value 0, the function first
+     * spins for a short time and then sleeps until it can decrement (post was
      * called).
      * 
-     * @see sem_wait
+     * @see futex(2) FUTEX_WAIT
      */
     void wait();
 
     /**
      * @brief Same as wait() but doesn't block if the value is 0.
      * 
-     * Tries to decrement the underlying semaphore using 
-     * sem_trywait. If the value is 0, it instantly returns false.
+     * Tries to decrement the counter. If the value is 0, it instantly returns
+     * false.
      * 
      * @return True if the semaphore was decremented, false otherwise.
-     * 
-     * @see sem_trywait
      */
     bool tryWait();
 
     /**
      * @brief Same as wait() but only blocks for a specified ammount of time.
      * 
-     * Tries to decrement the underlying semaphore using sem_timedwait. If the 
-     * value is 0, it will block until it can decrement or the specified time 
-     * in ms has passed. 
+     * Tries to decrement the counter. If the value is 0, it will block until it
+     * can decrement or the specified time in ms has passed. The time is measured
+     * with CLOCK_MONOTONIC, so changes of the system time don't affect it.
      * 
-     * @param ms The time in milliseconds that will be waited if the current 
+     * @param ms The time in milliseconds that will be waited if the current
      *  value is 0, before returning false.
      * 
      * @return True if the value could be decremented, false if the ms time has
-     *  passed without the possibility to decrement. 
-     * 
-     * @see sem_timedwait
+     *  passed without the possibility to decrement.
      */
     bool timedWait(long ms);
 
@@ -130,13 +148,9 @@ public:
      * 
      * @brief Get the current Semaphore value.
      * 
-     * Get the current value from the underlying semaphore using sem_getvalue.
-     * 
-     * @return The current semaphore value. (Due to the nature of semaphores 
-     *  and threads, the real value might have already changed when parsing this 
+     * @return The current semaphore value. (Due to the nature of semaphores
+     *  and threads, the real value might have already changed when parsing this
      *  result)
-     * 
-     * @see sem_getvalue
      */
     int getValue();
 
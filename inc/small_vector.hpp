@@ -0,0 +1,227 @@
+#ifndef _SMALL_VECTOR_HPP
+#define _SMALL_VECTOR_HPP
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/**
+ * @brief A vector that stores the first N items inline and only moves to the
+ * heap when more items are added.
+ *
+ * Items are kept contiguous in insertion order, so iterating is a linear scan
+ * over a flat array. For small collections like the headers of a request, this
+ * avoids both the allocations and the pointer chasing of node based containers.
+ *
+ * @tparam T The item type.
+ * @tparam N The number of items that fit into the inline buffer.
+ */
+template <typename T, size_t N>
+class SmallVector
+{
+private:
+
+    static_assert(N > 0, "SmallVector needs an inline capacity of at least 1");
+
+    /**
+     * @brief Storage for the inline items. Only the first _size slots are
+     * constructed while _data points here.
+     */
+    alignas(T) unsigned char inlineStorage[N * sizeof(T)];
+
+    T *_data;
+    size_t _size = 0;
+    size_t _capacity = N;
+
+    T * inlineData()
+    {
+        return std::launder(reinterpret_cast<T*>(inlineStorage));
+    }
+
+    bool isInline() const
+    {
+        return _data == reinterpret_cast<const T*>(inlineStorage);
+    }
+
+    /**
+     * @brief Move all items into a heap buffer with room for at least minCapacity
+     * items.
+     */
+    void grow(size_t minCapacity)
+    {
+        size_t newCapacity = _capacity * 2;
+        if (newCapacity < minCapacity)
+            newCapacity = minCapacity;
+
+        T *newData = static_cast<T*>(::operator new(newCapacity * sizeof(T), std::align_val_t{alignof(T)}));
+
+        std::uninitialized_move(_data, _data + _size, newData);
+        std::destroy(_data, _data + _size);
+
+        releaseHeap();
+
+        _data = newData;
+        _capacity = newCapacity;
+    }
+
+    void releaseHeap()
+    {
+        if (!isInline())
+            ::operator delete(_data, std::align_val_t{alignof(T)});
+    }
+
+public:
+
+    typedef T value_type;
+    typedef T * iterator;
+    typedef const T * const_iterator;
+
+    SmallVector()
+        : _data{inlineData()}
+    { }
+
+    SmallVector(const SmallVector & other)
+        : SmallVector()
+    {
+        reserve(other._size);
+        std::uninitialized_copy(other.begin(), other.end(), _data);
+        _size = other._size;
+    }
+
+    /**
+     * @brief Take over the items of other. A heap buffer is stolen, inline items
+     * are moved one by one. The moved-from vector is left empty.
+     */
+    SmallVector(SmallVector && other) noexcept(std::is_nothrow_move_constructible<T>::value)
+        : SmallVector()
+    {
+        if (other.isInline())
+        {
+            std::uninitialized_move(other.begin(), other.end(), _data);
+            _size = other._size;
+            other.clear();
+        }
+        else
+        {
+            _data = other._data;
+            _size = other._size;
+            _capacity = other._capacity;
+
+            other._data = other.inlineData();
+            other._size = 0;
+            other._capacity = N;
+        }
+    }
+
+    SmallVector & operator=(const SmallVector & other)
+    {
+        if (&other != this)
+        {
+            clear();
+            reserve(other._size);
+            std::uninitialized_copy(other.begin(), other.end(), _data);
+            _size = other._size;
+        }
+        return *this;
+    }
+
+    SmallVector & operator=(SmallVector && other) noexcept(std::is_nothrow_move_constructible<T>::value)
+    {
+        if (&other != this)
+        {
+            this->~SmallVector();
+            new (this) SmallVector(std::move(other));
+        }
+        return *this;
+    }
+
+    ~SmallVector()
+    {
+        clear();
+        releaseHeap();
+    }
+
+
+    size_t size() const { return _size; }
+
+    size_t capacity() const { return _capacity; }
+
+    bool empty() const { return _size == 0; }
+
+    T * data() { return _data; }
+    const T * data() const { return _data; }
+
+    iterator begin() { return _data; }
+    iterator end() { return _data + _size; }
+    const_iterator begin() const { return _data; }
+    const_iterator end() const { return _data + _size; }
+
+    T & operator[](size_t i) { return _data[i]; }
+    const T & operator[](size_t i) const { return _data[i]; }
+
+    T & back() { return _data[_size - 1]; }
+    const T & back() const { return _data[_size - 1]; }
+
+
+    /**
+     * @brief Make sure that at least capacity items fit without another
+     * allocation.
+     */
+    void reserve(size_t capacity)
+    {
+        if (capacity > _capacity)
+            grow(capacity);
+    }
+
+    template <typename... Args>
+    T & emplace_back(Args&&... args)
+    {
+        if (_size == _capacity)
+            grow(_size + 1);
+
+        T *item = new (_data + _size) T(std::forward<Args>(args)...);
+        _size++;
+
+        return *item;
+    }
+
+    void push_back(const T & item)
+    {
+        emplace_back(item);
+    }
+
+    void push_back(T && item)
+    {
+        emplace_back(std::move(item));
+    }
+
+    /**
+     * @brief Remove the item at pos, keeping the order of the remaining items.
+     *
+     * @return Iterator to the item that followed the removed one.
+     */
+    iterator erase(const_iterator pos)
+    {
+        iterator it = _data + (pos - _data);
+
+        std::move(it + 1, end(), it);
+        std::destroy_at(_data + _size - 1);
+        _size--;
+
+        return it;
+    }
+
+    /**
+     * @brief Destroy all items. The capacity (and a heap buffer) is kept.
+     */
+    void clear()
+    {
+        std::destroy(_data, _data + _size);
+        _size = 0;
+    }
+
+};
+
+#endif // _SMALL_VECTOR_HPP
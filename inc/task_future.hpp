@@ -0,0 +1,263 @@
+#ifndef _TASK_FUTURE_HPP
+#define _TASK_FUTURE_HPP
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <ctime>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+#include "futex.hpp"
+
+/**
+ * @brief One-shot signal that threads can wait for. Setting the signal only makes
+ * a syscall if a thread is sleeping on it.
+ */
+class TaskSignal
+{
+private:
+
+    static const uint32_t NOT_SET = 0;
+    static const uint32_t SET = 1;
+    static const uint32_t NOT_SET_WAITING = 2;
+
+    std::atomic<uint32_t> state{NOT_SET};
+
+public:
+
+    /**
+     * @brief Set the signal and wake up all waiting threads.
+     */
+    void set()
+    {
+        if (state.exchange(SET, std::memory_order_acq_rel) == NOT_SET_WAITING)
+        {
+            futexWake(&state, INT_MAX);
+        }
+    }
+
+    bool isSet() const
+    {
+        return state.load(std::memory_order_acquire) == SET;
+    }
+
+    /**
+     * @brief Sleep until the signal is set. May return spuriously or after the
+     * timeout, so the caller must check isSet() again.
+     * 
+     * @param timeout Optional relative timeout.
+     */
+    void wait(const timespec *timeout = nullptr)
+    {
+        uint32_t expected = NOT_SET;
+
+        // Announce the sleeper, so set() knows it has to wake up
+        if (!state.compare_exchange_strong(expected, NOT_SET_WAITING, std::memory_order_acquire)
+            && expected == SET)
+        {
+            return;
+        }
+
+        futexWait(&state, NOT_SET_WAITING, timeout);
+    }
+};
+
+/**
+ * @brief The shared state between a task submitted with Threadpool::submit() and
+ * its TaskFuture, without the result.
+ */
+struct TaskFutureStateBase
+{
+    TaskSignal done;
+
+    std::exception_ptr exception;
+
+    /**
+     * @brief Set by the thread that runs the task, which is either a worker or 
+     * the thread that waits for the result.
+     */
+    std::atomic<bool> claimed{false};
+
+    /**
+     * @brief Type erased call of the callable, set by TaskFutureStateWithFn.
+     */
+    void (*runTask)(TaskFutureStateBase &state) = nullptr;
+
+    /**
+     * @brief Run the task on the calling thread, unless another thread has 
+     * already started it.
+     * 
+     * @return True if the task was run by the calling thread.
+     */
+    bool tryRun()
+    {
+        if (claimed.exchange(true, std::memory_order_acq_rel))
+            return false;
+
+        runTask(*this);
+        return true;
+    }
+};
+
+/**
+ * @brief The shared state of a task and its future, including the result.
+ */
+template <typename R>
+struct TaskFutureState : TaskFutureStateBase
+{
+    /**
+     * @brief The result of the task. Tasks without a result store a monostate.
+     */
+    std::optional<std::conditional_t<std::is_void_v<R>, std::monostate, R>> value;
+};
+
+/**
+ * @brief The shared state of a submitted task, which also holds the callable. 
+ * Keeping the callable here means the pool task only captures one pointer, no 
+ * matter how large the callable is.
+ */
+template <typename R, typename Fn>
+struct TaskFutureStateWithFn : TaskFutureState<R>
+{
+    Fn fn;
+
+    explicit TaskFutureStateWithFn(Fn &&_fn)
+        : fn{std::move(_fn)}
+    {
+        this->runTask = [](TaskFutureStateBase &state) {
+            static_cast<TaskFutureStateWithFn&>(state).invoke();
+        };
+    }
+
+    /**
+     * @brief Run the callable, store the result or exception and signal the future.
+     */
+    void invoke()
+    {
+        try
+        {
+            if constexpr (std::is_void_v<R>)
+            {
+                fn();
+                this->value.emplace();
+            }
+            else
+            {
+                this->value.emplace(fn());
+            }
+        }
+        catch (...)
+        {
+            this->exception = std::current_exception();
+        }
+
+        this->done.set();
+    }
+};
+
+/**
+ * @brief The part of TaskFuture that doesn't depend on the result type.
+ */
+class TaskFutureBase
+{
+protected:
+
+    std::shared_ptr<TaskFutureStateBase> stateBase;
+
+    TaskFutureBase() = default;
+
+    TaskFutureBase(std::shared_ptr<TaskFutureStateBase> state)
+        : stateBase{std::move(state)}
+    { }
+
+public:
+
+    /**
+     * @brief True if the future refers to a task.
+     */
+    bool valid() const
+    {
+        return (bool)stateBase;
+    }
+
+    /**
+     * @brief True if the task has finished and get() won't block.
+     */
+    bool ready() const
+    {
+        return stateBase && stateBase->done.isSet();
+    }
+
+    /**
+     * @brief Wait until the task has finished. If no worker has started the task
+     * yet, the calling thread runs it itself. So a worker that waits for a task 
+     * it submitted can't deadlock the pool, even if all workers are waiting. 
+     * Other tasks of the pool are never run while waiting, since they might 
+     * block for a long time (e.g. connections). 
+     */
+    void wait() const;
+};
+
+/**
+ * @brief Future for the result of a task submitted with Threadpool::submit().
+ *
+ * @tparam R The result type of the task.
+ */
+template <typename R>
+class TaskFuture : public TaskFutureBase
+{
+private:
+
+    std::shared_ptr<TaskFutureState<R>> state;
+
+public:
+
+    TaskFuture() = default;
+
+    TaskFuture(std::shared_ptr<TaskFutureState<R>> _state)
+        : TaskFutureBase(_state), state{std::move(_state)}
+    { }
+
+    TaskFuture(TaskFuture &&other) = default;
+
+    TaskFuture & operator=(TaskFuture &&other) = default;
+
+    TaskFuture(const TaskFuture &other) = delete;
+
+    TaskFuture & operator=(const TaskFuture &other) = delete;
+
+    /**
+     * @brief Wait for the task (see wait()) and return its result. If the task 
+     * threw an exception, it is rethrown here. May only be called once.
+     */
+    R get()
+    {
+        if (!state)
+        {
+            throw std::runtime_error("TaskFuture has no task");
+        }
+
+        wait();
+
+        auto finished = std::move(state);
+        stateBase.reset();
+
+        if (finished->exception)
+        {
+            std::rethrow_exception(finished->exception);
+        }
+
+        if constexpr (!std::is_void_v<R>)
+        {
+            return std::move(*finished->value);
+        }
+    }
+};
+
+#endif // _TASK_FUTURE_HPP
@@ -1,13 +1,23 @@
 #ifndef _THREADPOOL_H
 #define _THREADPOOL_H
 
+#include <algorithm>
 #include <thread>
 #include <vector>
 #include <queue>
 #include <functional>
 #include <mutex>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <type_traits>
 
-#include "semaphore.hpp"
+#include "inplace_function.hpp"
+#include "event_count.hpp"
+#include "mpmc_queue.hpp"
+#include "work_stealing_deque.hpp"
+#include "task_future.hpp"
 
 /**
  * @brief A collection of worker threads that can work on tasks in a task queue.
@@ -21,13 +31,103 @@
  */
 class Threadpool
 {
+public:
+
+    /**
+     * @brief The strategy that is used to distribute tasks to the workers.
+     */
+    enum class Scheduling
+    {
+        /**
+         * @brief All tasks go into one shared queue and are processed in the 
+         * order they were added.
+         */
+        Fifo,
+        /**
+         * @brief Every worker has its own deque. Tasks that are added from inside 
+         * a worker are pushed onto that worker's deque, tasks from other threads 
+         * go into the shared queue. Idle workers steal tasks from random other 
+         * workers.
+         */
+        WorkStealing
+    };
+
+    /**
+     * @brief The number of bytes a task can capture without being rejected at 
+     * compile time. Together with the type erasure pointer a Task fills exactly 
+     * one cache line.
+     */
+    static const size_t TASK_INLINE_SIZE = 48;
+
+    /**
+     * @brief A task that can be executed by the threadpool. The callable is 
+     * stored inline and moved through the task queue, so adding and running a 
+     * task doesn't allocate. Only tasks that go to the overflow queue of an 
+     * unlimited backlog are allocated. Tasks that a worker spawns in work 
+     * stealing mode are stored in recycled task slots of the worker.
+     */
+    typedef InplaceFunction<void (), TASK_INLINE_SIZE> Task;
+
+    /**
+     * @brief Configuration for elastic sizing of the worker pool. See 
+     * enableElasticSizing().
+     */
+    struct ElasticLimits
+    {
+        /**
+         * @brief The pool never shrinks below this number of workers.
+         */
+        int minWorkers;
+
+        /**
+         * @brief The pool never grows beyond this number of workers.
+         */
+        int maxWorkers;
+
+        /**
+         * @brief A worker is added when a task waited longer than this in the 
+         * task queue, or when tasks are waiting and no worker took one for this
+         * long.
+         */
+        std::chrono::microseconds growDelay = std::chrono::milliseconds(5);
+
+        /**
+         * @brief A worker retires after it found no task for this long.
+         */
+        std::chrono::milliseconds idleTimeout = std::chrono::seconds(10);
+
+        /**
+         * @brief The minimum time between two workers being added. Short, so the
+         * pool reacts quickly to a load spike.
+         */
+        std::chrono::milliseconds growCooldown = std::chrono::milliseconds(50);
+
+        /**
+         * @brief The minimum time after any resize before a worker may retire. 
+         * This is the hysteresis that prevents growing and shrinking in quick 
+         * succession.
+         */
+        std::chrono::milliseconds shrinkCooldown = std::chrono::milliseconds(500);
+    };
+
+    /**
+     * @brief Called after the pool was resized in elastic mode, with the number 
+     * of workers before and after the resize.
+     */
+    typedef std::function<void (int oldSize, int newSize)> ResizeCallback;
+
 private:
 
     /**
      * @brief Indicated if a shutdown was initiated and the threadpool can no longer
      * accept new tasks.
      */
-    bool shutdownInitiated = false;
+    std::atomic<bool> shutdownInitiated{false};
+
+    /**
+     * @brief The scheduling strategy of the threadpool.
+     */
+    Scheduling scheduling;
 
     /**
      * @brief The number of concurrent workers in the threadpool
@@ -35,35 +135,167 @@ private:
     int numberOfWorkers;
 
     /**
-     * @brief The list of thread handles for the concurrent workers
+     * @brief The list of thread handles for the concurrent workers. In elastic 
+     * mode, the slots of retired workers are reused for new workers.
+     * 
+     * NOTE: In elastic mode the mtxWorkers mutex must be used to access this 
+     * variable.
      */
     std::vector<std::thread> workerThreads;
 
     /**
-     * @brief A task queue that contains functions that will be executed by the 
-     * workers threads in the same order as they were added (fifo).
+     * @brief Marks the slots in workerThreads whose worker has retired.
+     */
+    std::vector<bool> workerRetired;
+
+    /**
+     * @brief Mutex to synchronize resizing the pool in elastic mode.
+     */
+    std::mutex mtxWorkers;
+
+    /**
+     * @brief The number of workers that are currently running.
+     */
+    std::atomic<int> activeWorkers{0};
+
+    /**
+     * @brief Indicates if elastic sizing is enabled.
+     */
+    std::atomic<bool> elastic{false};
+
+    /**
+     * @brief The limits for elastic sizing. Only written before elastic is set.
+     */
+    ElasticLimits elasticLimits;
+
+    /**
+     * @brief Time of the last growth, used for the grow cooldown.
+     * 
+     * NOTE: Access must be synchronized with the mtxWorkers mutex.
+     */
+    std::chrono::steady_clock::time_point lastGrow;
+
+    /**
+     * @brief Time of the last resize in either direction, used for the shrink 
+     * cooldown.
+     * 
+     * NOTE: Access must be synchronized with the mtxWorkers mutex.
+     */
+    std::chrono::steady_clock::time_point lastResize;
+
+    /**
+     * @brief The time a worker last took a task from the taskQueue, or the time 
+     * the taskQueue last became non-empty, in steady_clock ticks. Only updated
+     * in elastic mode. If tasks are queued and this is older than the grow 
+     * delay, all workers are stuck on their tasks.
+     */
+    std::atomic<int64_t> lastQueueProgress{0};
+
+    /**
+     * @brief The number of times the pool grew or shrank in elastic mode.
+     */
+    std::atomic<uint64_t> resizeEvents{0};
+
+    ResizeCallback resizeCallback;
+
+    /**
+     * @brief Start a new worker thread in a free slot of workerThreads.
+     * 
+     * NOTE: mtxWorkers must be locked by the caller.
+     */
+    void startWorker();
+
+    /**
+     * @brief Add a worker if the pool is below the maximum size and the cooldown 
+     * has passed. Called when a task waited longer than the grow delay.
+     */
+    void growIfAllowed();
+
+    /**
+     * @brief Called before tasks are added in elastic mode. Grows the pool if 
+     * tasks are queued but no worker took a task for longer than the grow 
+     * delay. Unlike the check when a task is taken, this also works when all 
+     * workers are blocked by long running tasks.
+     */
+    void growIfBacklogged(std::chrono::steady_clock::time_point now);
+
+    /**
+     * @brief Wait until a worker took a task from the full queue. In elastic mode 
+     * the wait ends after the grow delay to check for a stuck backlog, since the 
+     * workers can't grow the pool while all of them are blocked.
+     *
+     * @param key The key returned by evSpaceAvailable.prepareWait().
+     */
+    void waitForSpace(uint32_t key);
+
+    /**
+     * @brief Retire the calling worker if the pool is above the minimum size and
+     * the cooldown has passed.
+     * 
+     * @return True if the worker must end, false if it must keep working.
+     */
+    bool retireIfAllowed(int workerId);
+
+    /**
+     * @brief The cpus the workers are pinned to. Empty if the workers are not pinned.
+     */
+    std::vector<int> affinityCpus;
+
+    /**
+     * @brief If true, every worker is pinned to a single cpu from affinityCpus. 
+     * Otherwise every worker may run on all of affinityCpus.
+     */
+    bool affinityPerWorker = false;
+
+    /**
+     * @brief Apply the configured cpu affinity to a worker thread.
+     * 
+     * @return True if the affinity was set, false if the system refused it.
+     */
+    bool applyAffinity(int workerId, std::thread &thread);
+
+    /**
+     * @brief A task in the task queue, together with the time it was added. The 
+     * time is only set in elastic mode, where it is used to measure the 
+     * queueing delay.
+     */
+    struct QueuedTask
+    {
+        Task task;
+        std::chrono::steady_clock::time_point enqueued;
+    };
+
+    /**
+     * @brief A bounded lock-free task queue that contains functions that will be 
+     * executed by the workers threads in the same order as they were added (fifo).
+     * 
+     * The capacity is maxQueueBacklog, or UNLIMITED_QUEUE_RING_SIZE if the backlog
+     * is unlimited.
+     */
+    std::unique_ptr<MpmcQueue<QueuedTask>> taskQueue;
+
+    /**
+     * @brief Takes the tasks that don't fit into the taskQueue if the backlog is 
+     * unlimited. Once the overflow queue contains tasks, new tasks are added here
+     * as well, so the fifo order is kept.
      * 
-     * NOTE: The access is not synchronized by default and the mtxTaskQueue mutex
+     * NOTE: The access is not synchronized by default and the mtxOverflowQueue mutex
      * must be used to access this variable.
      */
     std::queue <
-        std::function<void ()>
-    > taskQueue;
+        QueuedTask
+    > overflowQueue;
 
     /**
-     * @brief Mutex to synchronize access to the taskQueue variable.
+     * @brief Mutex to synchronize access to the overflowQueue variable.
      */
-    std::mutex mtxTaskQueue;
+    std::mutex mtxOverflowQueue;
 
     /**
-     * @brief This semaphore is used to notify the workers that there are tasks available.
-     * The value represents te number of open tasks in the taskQueue. Workers will
-     * therefore wait if there are no tasks and continue if tasks get added to the 
-     * taskQueue. 
-     * 
-     * The semaphore has is posted when tasks are added to the taskQueue.
+     * @brief The number of tasks in the overflowQueue. Allows skipping the lock 
+     * if the overflow queue is empty, which is the normal case.
      */
-    Semaphore semWaitForTask;
+    std::atomic<int64_t> overflowTasks{0};
 
     /**
      * @brief The maximum number of open tasks in the taskQueue. If this number 
@@ -72,13 +304,87 @@ private:
     int maxQueueBacklog;
 
     /**
-     * @brief This semaphore is used to limit the number of open tasks on the taskQueue.
-     * 
-     * It is initialized with the max number of open tasks (maxQueueBacklog) and 
-     * the addTask function waits on the semaphore while the workers post it 
-     * after removing a task from the taskQueue.
+     * @brief addTask() waits on this event count while the taskQueue is full. 
+     * Workers notify it after taking a task.
+     */
+    EventCount evSpaceAvailable;
+
+    struct WorkerQueue;
+
+    /**
+     * @brief A task spawned by a worker in work stealing mode. Slots are owned 
+     * by the deque of the worker that spawned the task and are returned to it 
+     * after the task has run, so spawning a task doesn't allocate.
      */
-    Semaphore semTaskQueueLimit;
+    struct TaskSlot
+    {
+        Task task;
+
+        TaskSlot *nextFree = nullptr;
+
+        WorkerQueue *home = nullptr;
+    };
+
+    /**
+     * @brief The number of task slots that are allocated at once.
+     */
+    static const size_t TASK_SLAB_SIZE = 64;
+
+    /**
+     * @brief The local task deque of a worker in work stealing mode. Each deque 
+     * is on its own cache line to avoid false sharing between workers.
+     */
+    struct alignas(64) WorkerQueue
+    {
+        WorkStealingDeque<TaskSlot*> deque;
+
+        /**
+         * @brief Free slots, only accessed by the owning worker.
+         */
+        TaskSlot *freeSlots = nullptr;
+
+        /**
+         * @brief All slots of the deque, they live as long as the threadpool. 
+         * Only accessed by the owning worker.
+         */
+        std::vector<std::unique_ptr<TaskSlot[]>> slabs;
+
+        /**
+         * @brief Slots of tasks that other threads ran. Any thread pushes, the 
+         * owning worker takes the whole list at once.
+         */
+        alignas(64) std::atomic<TaskSlot*> returnedSlots{nullptr};
+
+        /**
+         * @brief Take a free slot. Must only be called by the owning worker.
+         */
+        TaskSlot * acquireSlot();
+
+        /**
+         * @brief Give back a slot whose task has run.
+         * 
+         * @param byOwner True if the calling thread is the owning worker.
+         */
+        void releaseSlot(TaskSlot *slot, bool byOwner);
+    };
+
+    /**
+     * @brief The local deques of the workers, indexed by the worker id. Only used
+     * in work stealing mode.
+     */
+    std::vector<std::unique_ptr<WorkerQueue>> workerQueues;
+
+    /**
+     * @brief The number of tasks that were added but not yet taken by a worker
+     * in work stealing mode, counting the taskQueue and all worker deques.
+     */
+    std::atomic<int64_t> pendingTasks{0};
+
+    /**
+     * @brief Idle workers park on this event count while there are no tasks. 
+     * Adding a task only wakes a worker if there are parked workers.
+     */
+    EventCount evTaskAvailable;
 
     /**
      * @brief Internal worker function that waits for and then completes tasks from 
@@ -87,12 +393,138 @@ private:
      * @param workerId The id of the current worker
      */
     void workLoop(int workerId);
+
+    /**
+     * @brief Internal worker function for work stealing mode. Works on the local 
+     * deque first, then on the shared queue and then tries to steal from other 
+     * workers. Parks the worker if no task was found.
+     * 
+     * @param workerId The id of the current worker
+     */
+    void workLoopStealing(int workerId);
+
+    /**
+     * @brief Find and run one task in work stealing mode.
+     * 
+     * @param workerId The id of the calling worker.
+     * 
+     * @param rng State of the random number generator used to pick victims.
+     * 
+     * @return True if a task was run, false if no task was found.
+     */
+    bool runNextTask(int workerId, uint32_t &rng);
+
+    /**
+     * @brief Run the task of a slot taken from a deque and give the slot back.
+     * 
+     * @param workerId The id of the calling worker, or -1.
+     */
+    void runTaskSlot(TaskSlot *slot, int workerId);
+
+    /**
+     * @brief Take the next task from the taskQueue or the overflowQueue.
+     * 
+     * @return True if a task was taken, false if the queues were empty.
+     */
+    bool takeQueuedTask(Task &task);
+
+    /**
+     * @brief Take up to max tasks from the taskQueue or the overflowQueue at once.
+     * 
+     * @param tasks Receives the tasks in fifo order.
+     * 
+     * @param max The maximum number of tasks, at most TASK_BATCH_SIZE.
+     * 
+     * @return The number of tasks taken, 0 if the queues were empty.
+     */
+    size_t takeQueuedTasks(Task *tasks, size_t max);
+
+    /**
+     * @brief The number of tasks a worker should take at once, which is its fair 
+     * share of the queued tasks. Taking more would leave other workers idle while
+     * the tasks wait in the batch of one worker.
+     */
+    size_t batchSizeForWorker() const;
+
+    /**
+     * @brief Add a task to the taskQueue, or the overflowQueue if the backlog is
+     * unlimited and the taskQueue is full.
+     * 
+     * @param task The task to add. It is only moved from if it was added.
+     * 
+     * @param blocking Wait for space if the backlog limit is reached.
+     * 
+     * @return True if the task was added, false if the queue is full and 
+     *  blocking is false.
+     */
+    bool enqueueTask(Task &&task, bool blocking);
+
+    /**
+     * @brief Add a batch of tasks to the taskQueue, or the overflowQueue if the 
+     * backlog is unlimited and the taskQueue is full. The cells for the batch are
+     * reserved with one atomic operation, and the workers are woken up with one 
+     * notification per reserved part. Blocks while the backlog limit is reached.
+     */
+    void enqueueTasks(QueuedTask *items, size_t count);
+
+    /**
+     * @brief Add a batch of tasks, used by addTasks().
+     */
+    void addTaskBatch(QueuedTask *items, size_t count);
+
+    /**
+     * @brief Push a task onto the deque of the calling worker in work stealing mode.
+     */
+    void pushLocalTask(Task &&task);
+
+    /**
+     * @brief The shared state of a parallelFor() call. The chunks are claimed 
+     * dynamically by the caller and the helper tasks, so uneven chunks are 
+     * balanced automatically.
+     */
+    struct ParallelForState
+    {
+        size_t begin;
+        size_t end;
+        size_t grain;
+        size_t chunks;
+
+        /**
+         * @brief Type erased loop body, called with the bounds of a chunk.
+         */
+        void *body;
+        void (*runChunk)(void *body, size_t chunkBegin, size_t chunkEnd);
+
+        std::atomic<size_t> nextChunk{0};
+        std::atomic<size_t> finishedChunks{0};
+
+        TaskSignal done;
+
+        std::atomic<bool> failed{false};
+        std::exception_ptr exception;
+    };
+
+    /**
+     * @brief Claim and run chunks until all chunks are claimed.
+     */
+    static void runParallelChunks(ParallelForState &state);
+
+    /**
+     * @brief Run the chunks of the state on the calling thread and up to one 
+     * helper task per worker, then wait until all chunks are finished.
+     */
+    void runParallelFor(const std::shared_ptr<ParallelForState> &state);
     
 public:
 
+    /**
+     * @brief The maximum number of tasks that are added or taken by a worker at once.
+     */
+    static const size_t TASK_BATCH_SIZE = 16;
+
     /**
      * @brief Automatically determine the number of threads to use in the threadpool.
-     * This will use (number of logical cores / 2) as the number of threads.
+     * This will use the number of physical cores as the number of threads.
      */
     static const int AUTO_NO_WORKERS = 0;
 
@@ -101,6 +533,12 @@ public:
      */
     static const int DISABLE_MAX_QUEUE_BACKLOG = 0;
 
+    /**
+     * @brief The size of the lock-free task queue if the backlog is unlimited. 
+     * Tasks beyond this number go to a mutex protected overflow queue.
+     */
+    static const int UNLIMITED_QUEUE_RING_SIZE = 1024;
+
     /**
      * @brief Create a new Threadpool with the specified number of worker threads 
      * and maximum queue backlog.
@@ -114,8 +552,21 @@ public:
      * 
      * @param maxQueueBacklog The number of open tasks in the task queue before the 
      * addTask method will block.
+     * 
+     * @param scheduling The strategy used to distribute the tasks to the workers.
+     */
+    Threadpool(int numberOfWorkers = AUTO_NO_WORKERS, int maxQueueBacklog = DISABLE_MAX_QUEUE_BACKLOG,
+        Scheduling scheduling = Scheduling::Fifo);
+
+    Threadpool(const Threadpool &other) = delete;
+
+    Threadpool & operator=(const Threadpool &other) = delete;
+
+    /**
+     * @brief Shut the threadpool down and wait until the workers have finished 
+     * all open tasks. Must not be called from a worker of the threadpool.
      */
-    Threadpool(int numberOfWorkers = AUTO_NO_WORKERS, int maxQueueBacklog = DISABLE_MAX_QUEUE_BACKLOG);
+    ~Threadpool();
 
     /**
      * @brief Add a task to the task queue to be processed by the threadpool.
@@ -123,13 +574,228 @@ public:
      * maxQueueBacklog this function will block until tasks are removed from the 
      * queue by the worker threads.
      * 
+     * In work stealing mode, tasks that are added by a worker of this threadpool 
+     * are pushed onto the worker's own deque. This never blocks and doesn't 
+     * count towards maxQueueBacklog.
+     * 
      * @param task The task function to be executed by the threadpool.
      * 
      * @warning This function will block if the number of open tasks in the 
      * threadpool is equal to the value of maxQueueBacklog this function will 
      * block until tasks are removed from the queue by the worker threads.
      */
-    void addTask(std::function<void ()> task);
+    void addTask(Task &&task);
+
+    /**
+     * @brief Add all tasks of the range at once. Compared to calling addTask() for 
+     * every task, the queue is synchronized once per batch of up to 
+     * TASK_BATCH_SIZE tasks, and as many workers as there are new tasks are 
+     * woken up with one notification.
+     * 
+     * Blocks like addTask() while the backlog limit is reached.
+     * 
+     * @param first, last The range of Task objects. The tasks are moved from.
+     */
+    template <typename It>
+    void addTasks(It first, It last)
+    {
+        QueuedTask batch[TASK_BATCH_SIZE];
+
+        while (first != last)
+        {
+            size_t count = 0;
+
+            for (; count < TASK_BATCH_SIZE && first != last; ++first, ++count)
+            {
+                batch[count].task = std::move(*first);
+            }
+
+            addTaskBatch(batch, count);
+        }
+    }
+
+    /**
+     * @brief Same as addTask() but never blocks. If the task queue is full, the
+     * task is not added and stays untouched.
+     * 
+     * @param task The task function to be executed by the threadpool. It is only
+     * moved from if the task was added.
+     * 
+     * @return True if the task was added, false if the task queue is full.
+     */
+    bool tryAddTask(Task &&task);
+
+    /**
+     * @brief Run the callable on the threadpool and get a future for its result.
+     * 
+     * If the task queue is full, the callable is run on the calling thread 
+     * right away instead of blocking. This keeps submit() safe to call from 
+     * inside a task, also with a queue backlog limit.
+     * 
+     * @param fn The callable without arguments. Its size is not limited by 
+     *  TASK_INLINE_SIZE, since it is stored with the shared state of the future.
+     * 
+     * @return The future for the result of fn.
+     */
+    template <typename Fn>
+    TaskFuture<std::invoke_result_t<std::decay_t<Fn>>> submit(Fn &&fn)
+    {
+        typedef std::invoke_result_t<std::decay_t<Fn>> R;
+
+        auto state = std::make_shared<TaskFutureStateWithFn<R, std::decay_t<Fn>>>(
+            std::decay_t<Fn>(std::forward<Fn>(fn))
+        );
+
+        // The task does nothing if the thread that waits for the future has 
+        // already run it
+        Task task([state]() { state->tryRun(); });
+
+        if (!tryAddTask(std::move(task)))
+        {
+            task();
+        }
+
+        return TaskFuture<R>(std::move(state));
+    }
+
+    /**
+     * @brief Call fn(i) for every i in [begin, end), split into chunks of grain 
+     * indices that are run in parallel by the workers and the calling thread. 
+     * Returns once all calls have finished. If a call throws, the first exception
+     * is rethrown after all chunks have finished.
+     * 
+     * Calling parallelFor() from inside a task of the same threadpool is allowed, 
+     * the calling worker works on the chunks itself.
+     * 
+     * @param grain The number of indices per chunk. Larger chunks have less 
+     *  overhead, smaller chunks balance better.
+     */
+    template <typename Fn>
+    void parallelFor(size_t begin, size_t end, size_t grain, Fn &&fn)
+    {
+        if (begin >= end) return;
+        if (grain < 1) grain = 1;
+
+        typedef std::remove_reference_t<Fn> Body;
+
+        auto state = std::make_shared<ParallelForState>();
+        state->begin = begin;
+        state->end = end;
+        state->grain = grain;
+        state->chunks = (end - begin + grain - 1) / grain;
+        state->body = (void*)&fn;
+        state->runChunk = [](void *body, size_t chunkBegin, size_t chunkEnd) {
+            Body &bodyFn = *static_cast<Body*>(body);
+
+            for (size_t i = chunkBegin; i < chunkEnd; i++)
+            {
+                bodyFn(i);
+            }
+        };
+
+        runParallelFor(state);
+    }
+
+    /**
+     * @brief Reduce map(i) for every i in [begin, end) with combine, in parallel.
+     * Every chunk is reduced starting from identity, and the chunk results are 
+     * combined in index order, so the result is deterministic for associative 
+     * operations.
+     * 
+     * @param identity The neutral element of combine.
+     * 
+     * @param map Called as map(i) and returns a T.
+     * 
+     * @param combine Called as combine(T a, T b) and returns a T.
+     */
+    template <typename T, typename Map, typename Combine>
+    T parallelReduce(size_t begin, size_t end, size_t grain, T identity, Map &&map, Combine &&combine)
+    {
+        if (begin >= end) return identity;
+        if (grain < 1) grain = 1;
+
+        size_t chunks = (end - begin + grain - 1) / grain;
+
+        // Every chunk result has its own cache line. Chunks are written by 
+        // different workers, so they must not share a word (std::vector<bool>)
+        // and should not share a line
+        struct alignas(64) Partial
+        {
+            T value;
+        };
+
+        std::vector<Partial> partials(chunks, Partial{identity});
+
+        parallelFor(0, chunks, 1, [&](size_t chunk) {
+            size_t chunkBegin = begin + chunk * grain;
+            size_t chunkEnd = std::min(chunkBegin + grain, end);
+
+            T acc = identity;
+
+            for (size_t i = chunkBegin; i < chunkEnd; i++)
+            {
+                acc = combine(std::move(acc), map(i));
+            }
+
+            partials[chunk].value = std::move(acc);
+        });
+
+        T result = std::move(identity);
+
+        for (auto &partial : partials)
+        {
+            result = combine(std::move(result), std::move(partial.value));
+        }
+
+        return result;
+    }
+
+    /**
+     * @brief Pin the worker threads to the given cpus. See CpuTopology for 
+     * finding the physical cores or the cpus of a NUMA node.
+     * 
+     * @param cpus The logical cpu numbers to pin the workers to.
+     * 
+     * @param onePerWorker If true, worker i is pinned to cpus[i % cpus.size()] 
+     * only. If false, every worker can run on any of the cpus, which is the 
+     * right choice for keeping a pool on one NUMA node.
+     * 
+     * @return True if all workers were pinned, false if the system refused the 
+     * affinity for at least one worker (e.g. cpus outside the allowed set).
+     */
+    bool pinWorkers(const std::vector<int> &cpus, bool onePerWorker = true);
+
+    /**
+     * @brief Let the pool grow and shrink between the given limits, depending on
+     * the load. A worker is added when tasks wait in the queue for longer than 
+     * limits.growDelay, and workers retire after being idle for 
+     * limits.idleTimeout. Workers are added at most once per 
+     * limits.growCooldown, and retire at the earliest limits.shrinkCooldown 
+     * after the last resize.
+     * 
+     * Elastic sizing is only supported with fifo scheduling. If the pool has 
+     * less than limits.minWorkers workers, it is grown right away.
+     * 
+     * @param limits The bounds and thresholds for resizing.
+     */
+    void enableElasticSizing(const ElasticLimits &limits);
+
+    /**
+     * @brief Set a callback that is called after every resize in elastic mode. 
+     * The callback is called from a worker thread. Must be set before elastic 
+     * sizing is enabled.
+     */
+    void setResizeCallback(ResizeCallback callback);
+
+    /**
+     * @brief Get the number of workers that are currently running.
+     */
+    int getNumberOfWorkers() const;
+
+    /**
+     * @brief Get the number of times the pool was resized in elastic mode.
+     */
+    uint64_t getResizeEvents() const;
 
     /**
      * @brief Block until all of the worker threads have ended.
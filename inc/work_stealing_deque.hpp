@@ -0,0 +1,194 @@
+#ifndef _WORK_STEALING_DEQUE_HPP
+#define _WORK_STEALING_DEQUE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @brief Lock-free Chase-Lev work stealing deque.
+ *
+ * The owning thread pushes and pops items at the bottom end (lifo), while any
+ * number of other threads can steal items from the top end (fifo). Pushing and
+ * popping by the owner only needs a CAS when the deque has a single item left.
+ *
+ * The buffer grows when it is full. Replaced buffers are kept until the deque is
+ * destroyed, since thieves might still read from them.
+ *
+ * The implementation follows "Correct and Efficient Work-Stealing for Weak Memory
+ * Models" (Le, Pop, Cohen, Zappa Nardelli, 2013).
+ *
+ * @tparam T The item type. Must be trivially copyable, typically a pointer.
+ */
+template <typename T>
+class WorkStealingDeque
+{
+private:
+
+    static_assert(std::is_trivially_copyable<T>::value, "WorkStealingDeque items must be trivially copyable");
+
+    /**
+     * @brief Circular buffer with a power of two capacity.
+     */
+    struct Buffer
+    {
+        int64_t capacity;
+        std::unique_ptr<std::atomic<T>[]> items;
+
+        Buffer(int64_t capacity)
+            : capacity{capacity}, items{new std::atomic<T>[capacity]}
+        { }
+
+        T get(int64_t i) const
+        {
+            return items[i & (capacity - 1)].load(std::memory_order_relaxed);
+        }
+
+        void put(int64_t i, T item)
+        {
+            items[i & (capacity - 1)].store(item, std::memory_order_relaxed);
+        }
+    };
+
+    /**
+     * @brief Index of the oldest item. Incremented by thieves and by the owner
+     * when taking the last item.
+     */
+    alignas(64) std::atomic<int64_t> top{0};
+
+    /**
+     * @brief Index after the newest item. Only written by the owner.
+     */
+    alignas(64) std::atomic<int64_t> bottom{0};
+
+    std::atomic<Buffer*> buffer;
+
+    /**
+     * @brief All buffers ever allocated, including the current one. Only accessed
+     * by the owner.
+     */
+    std::vector<std::unique_ptr<Buffer>> buffers;
+
+    Buffer * grow(Buffer *old, int64_t b, int64_t t)
+    {
+        buffers.push_back(std::make_unique<Buffer>(old->capacity * 2));
+        Buffer *bigger = buffers.back().get();
+
+        for (int64_t i = t; i < b; i++)
+        {
+            bigger->put(i, old->get(i));
+        }
+
+        buffer.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+
+public:
+
+    /**
+     * @param initialCapacity The initial number of item slots. Must be a power of two.
+     */
+    WorkStealingDeque(int64_t initialCapacity = 256)
+    {
+        buffers.push_back(std::make_unique<Buffer>(initialCapacity));
+        buffer.store(buffers.back().get(), std::memory_order_relaxed);
+    }
+
+    WorkStealingDeque(const WorkStealingDeque &other) = delete;
+
+    WorkStealingDeque & operator=(const WorkStealingDeque &other) = delete;
+
+    /**
+     * @brief Push an item at the bottom. Must only be called by the owner.
+     */
+    void push(T item)
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        Buffer *buf = buffer.load(std::memory_order_relaxed);
+
+        if (b - t > buf->capacity - 1)
+        {
+            buf = grow(buf, b, t);
+        }
+
+        buf->put(b, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Pop the newest item from the bottom. Must only be called by the owner.
+     *
+     * @return True if an item was taken, false if the deque was empty.
+     */
+    bool pop(T &item)
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        Buffer *buf = buffer.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+
+        if (t > b)
+        {
+            // The deque was empty
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        item = buf->get(b);
+
+        if (t == b)
+        {
+            // Last item, race against the thieves for it
+            bool won = top.compare_exchange_strong(t, t + 1,
+                std::memory_order_seq_cst, std::memory_order_relaxed);
+
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Steal the oldest item from the top. Can be called by any thread.
+     *
+     * @return True if an item was stolen, false if the deque was empty or another
+     *  thread took the item first.
+     */
+    bool steal(T &item)
+    {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+
+        if (t >= b)
+        {
+            return false;
+        }
+
+        Buffer *buf = buffer.load(std::memory_order_acquire);
+        item = buf->get(t);
+
+        return top.compare_exchange_strong(t, t + 1,
+            std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Check if the deque is empty. The result may already be outdated when
+     * other threads access the deque concurrently.
+     */
+    bool empty() const
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_relaxed);
+        return t >= b;
+    }
+
+};
+
+#endif // _WORK_STEALING_DEQUE_HPP
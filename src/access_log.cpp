@@ -0,0 +1,273 @@
+#include "access_log.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <ctime>
+
+/**
+ * @brief Batches are written out as soon as they reach this size.
+ */
+static const size_t ACCESS_LOG_BATCH_SIZE = 64 * 1024;
+
+std::atomic<uint64_t> AccessLog::nextLogId{1};
+
+/**
+ * @brief Per thread cache of the ring buffer that belongs to the calling thread.
+ * When the thread exits, the buffer is released so a new thread can take it over.
+ */
+struct AccessLog::LocalBufferCache
+{
+    uint64_t logId = 0;
+
+    std::shared_ptr<AccessLog::RecordBuffer> buffer;
+
+    ~LocalBufferCache()
+    {
+        if (buffer) buffer->claimed.store(false, std::memory_order_release);
+    }
+};
+
+
+AccessLog::RecordBuffer::RecordBuffer(size_t capacity)
+    : records(capacity)
+{ }
+
+bool AccessLog::RecordBuffer::tryPush(const AccessLogRecord &record)
+{
+    size_t h = head.load(std::memory_order_relaxed);
+
+    if (h - tail.load(std::memory_order_acquire) == records.size())
+    {
+        return false;
+    }
+
+    records[h & (records.size() - 1)] = record;
+    head.store(h + 1, std::memory_order_release);
+
+    return true;
+}
+
+bool AccessLog::RecordBuffer::tryPop(AccessLogRecord &record)
+{
+    size_t t = tail.load(std::memory_order_relaxed);
+
+    if (t == head.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+
+    record = records[t & (records.size() - 1)];
+    tail.store(t + 1, std::memory_order_release);
+
+    return true;
+}
+
+
+AccessLog::AccessLog(int fd, size_t _bufferCapacity, std::chrono::milliseconds flushInterval)
+    : logId{nextLogId.fetch_add(1)}, fd{fd}, bufferCapacity{1}, flushInterval{flushInterval}
+{
+    while (bufferCapacity < _bufferCapacity) bufferCapacity <<= 1;
+
+    writerThread = std::thread(&AccessLog::writeLoop, this);
+}
+
+AccessLog::~AccessLog()
+{
+    {
+        std::unique_lock<std::mutex> lock(mtxStop);
+        stopRequested = true;
+    }
+    cvStop.notify_all();
+
+    writerThread.join();
+}
+
+AccessLog::RecordBuffer & AccessLog::localBuffer()
+{
+    thread_local AccessLog::LocalBufferCache cache;
+
+    if (cache.logId == logId)
+    {
+        return *cache.buffer;
+    }
+
+    // Slow path, only taken the first time a thread logs to this AccessLog
+    std::unique_lock<std::mutex> lock(mtxBuffers);
+
+    std::shared_ptr<RecordBuffer> buffer;
+
+    for (auto &b : buffers)
+    {
+        if (b->owner == std::this_thread::get_id() && b->claimed.load(std::memory_order_acquire))
+        {
+            buffer = b;
+            break;
+        }
+    }
+
+    // Take over the buffer of a thread that has already exited
+    for (auto it = buffers.begin(); !buffer && it != buffers.end(); it++)
+    {
+        bool expected = false;
+        if ((*it)->claimed.compare_exchange_strong(expected, true, std::memory_order_acquire))
+        {
+            buffer = *it;
+        }
+    }
+
+    if (!buffer)
+    {
+        buffer = std::make_shared<RecordBuffer>(bufferCapacity);
+        buffer->claimed.store(true, std::memory_order_relaxed);
+        buffers.push_back(buffer);
+    }
+
+    buffer->owner = std::this_thread::get_id();
+
+    if (cache.buffer) cache.buffer->claimed.store(false, std::memory_order_release);
+
+    cache.logId = logId;
+    cache.buffer = buffer;
+
+    return *buffer;
+}
+
+void AccessLog::log(const AccessLogRecord &record)
+{
+    RecordBuffer &buffer = localBuffer();
+
+    if (!buffer.tryPush(record))
+    {
+        buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+uint64_t AccessLog::getDroppedRecords()
+{
+    std::unique_lock<std::mutex> lock(mtxBuffers);
+
+    uint64_t dropped = 0;
+    for (auto &b : buffers)
+    {
+        dropped += b->dropped.load(std::memory_order_relaxed);
+    }
+
+    return dropped;
+}
+
+void AccessLog::formatRecord(const AccessLogRecord &record, std::string &out)
+{
+    time_t secs = record.timestampUs / 1000000;
+    long usecs = record.timestampUs % 1000000;
+
+    tm t;
+    gmtime_r(&secs, &t);
+
+    char line[256];
+    int len = snprintf(line, sizeof(line),
+        "%s:%u [%04d-%02d-%02dT%02d:%02d:%02d.%06ldZ] \"%s %s\" %u %llu %uus\n",
+        record.ip, record.port,
+        t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec, usecs,
+        record.method, record.uri, record.status,
+        (unsigned long long)record.bytesSent, record.latencyUs
+    );
+
+    if (len > 0)
+    {
+        out.append(line, (size_t)len < sizeof(line) ? len : sizeof(line) - 1);
+    }
+}
+
+void AccessLog::writeAll(const std::string &data)
+{
+    size_t written_total = 0;
+
+    while (written_total < data.size())
+    {
+        ssize_t written = write(fd, data.data() + written_total, data.size() - written_total);
+
+        if (written < 0)
+        {
+            if (errno == EINTR) continue;
+
+            // There is nowhere to report a broken log output, so the batch is lost
+            return;
+        }
+
+        written_total += written;
+    }
+}
+
+size_t AccessLog::flush(std::string &batch)
+{
+    size_t count = 0;
+    uint64_t dropped = 0;
+
+    AccessLogRecord record;
+
+    {
+        std::unique_lock<std::mutex> lock(mtxBuffers);
+        drainBuffers.assign(buffers.begin(), buffers.end());
+    }
+
+    // The writer thread is the only consumer of the ring buffers, so they are 
+    // drained and written without the lock
+    for (auto &b : drainBuffers)
+    {
+        while (b->tryPop(record))
+        {
+            formatRecord(record, batch);
+            count++;
+
+            if (batch.size() >= ACCESS_LOG_BATCH_SIZE)
+            {
+                writeAll(batch);
+                batch.clear();
+            }
+        }
+
+        dropped += b->dropped.load(std::memory_order_relaxed);
+    }
+
+    if (dropped > reportedDropped)
+    {
+        batch += "access log: " + std::to_string(dropped - reportedDropped) + " records dropped\n";
+        reportedDropped = dropped;
+    }
+
+    if (!batch.empty())
+    {
+        writeAll(batch);
+        batch.clear();
+    }
+
+    return count;
+}
+
+void AccessLog::writeLoop()
+{
+    std::string batch;
+    batch.reserve(ACCESS_LOG_BATCH_SIZE);
+
+    while (true)
+    {
+        size_t count = flush(batch);
+
+        std::unique_lock<std::mutex> lock(mtxStop);
+
+        if (stopRequested)
+        {
+            lock.unlock();
+
+            // Write out everything that was logged before the shutdown
+            flush(batch);
+            return;
+        }
+
+        // Only sleep if the buffers are not filling up faster than they are drained
+        if (count < bufferCapacity / 2)
+        {
+            cvStop.wait_for(lock, flushInterval, [this]() { return stopRequested; });
+        }
+    }
+}
@@ -0,0 +1,261 @@
+#include "async_io.hpp"
+
+#include <algorithm>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "http_err.hpp"
+#include "threadpool.hpp"
+
+// The sockets of the server are blocking, because the synchronous handlers use 
+// them as well. MSG_DONTWAIT makes only the single call non-blocking
+
+AsyncWrite::AsyncWrite(int sockfd, std::pmr::string prefix, const uint8_t *data, size_t dataLength, 
+    size_t *bytesSent)
+        : sockfd{sockfd}, prefix{std::move(prefix)}, data{data}, dataLength{dataLength}, 
+          bytesSent{bytesSent}
+{ }
+
+bool AsyncWrite::tryWrite()
+{
+    size_t total = prefix.size() + dataLength;
+
+    while (written < total)
+    {
+        const uint8_t *src;
+        size_t length;
+
+        if (written < prefix.size())
+        {
+            src = (const uint8_t*)prefix.data() + written;
+            length = prefix.size() - written;
+        }
+        else
+        {
+            src = data + (written - prefix.size());
+            length = total - written;
+        }
+
+        ssize_t n = ::send(sockfd, src, length, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return false;
+
+            failed = true;
+            return true;
+        }
+
+        written += n;
+        if (bytesSent) *bytesSent += n;
+    }
+
+    return true;
+}
+
+bool AsyncWrite::await_ready()
+{
+    return tryWrite();
+}
+
+void AsyncWrite::await_suspend(std::coroutine_handle<> h)
+{
+    handle = h;
+    IoLoop::getDefault().waitFd(sockfd, EPOLLOUT, this);
+}
+
+void AsyncWrite::await_resume()
+{
+    if (failed)
+    {
+        throw HttpException(HttpException::TcpSend);
+    }
+}
+
+void AsyncWrite::onReady()
+{
+    if (tryWrite())
+        handle.resume();
+    else
+        IoLoop::getDefault().waitFd(sockfd, EPOLLOUT, this);
+}
+
+
+AsyncRead::AsyncRead(int sockfd, uint8_t *buffer, size_t bufferLength, size_t *remaining)
+    : sockfd{sockfd}, buffer{buffer}, bufferLength{bufferLength}, remaining{remaining}
+{ }
+
+AsyncRead::AsyncRead(size_t bytesRead)
+    : sockfd{-1}, buffer{nullptr}, bufferLength{0}, bytesRead{(ssize_t)bytesRead}, remaining{nullptr}
+{ }
+
+bool AsyncRead::tryRead()
+{
+    if (!remaining)
+        return true;
+
+    size_t length = std::min(bufferLength, *remaining);
+
+    if (length == 0)
+        return true;
+
+    while (true)
+    {
+        ssize_t n = ::recv(sockfd, buffer, length, MSG_DONTWAIT);
+
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return false;
+        }
+
+        bytesRead = n;
+
+        // The peer closed the connection before sending the full body or the 
+        // read failed, so there is nothing more to read
+        *remaining = n > 0 ? *remaining - n : 0;
+
+        return true;
+    }
+}
+
+bool AsyncRead::await_ready()
+{
+    return tryRead();
+}
+
+void AsyncRead::await_suspend(std::coroutine_handle<> h)
+{
+    handle = h;
+    IoLoop::getDefault().waitFd(sockfd, EPOLLIN, this);
+}
+
+size_t AsyncRead::await_resume()
+{
+    if (bytesRead < 0)
+    {
+        throw HttpException(HttpException::TcpRecv);
+    }
+
+    return bytesRead;
+}
+
+void AsyncRead::onReady()
+{
+    if (tryRead())
+        handle.resume();
+    else
+        IoLoop::getDefault().waitFd(sockfd, EPOLLIN, this);
+}
+
+
+/**
+ * @brief The threads that do the file reads for AsyncFileRead. The pool is never 
+ * destroyed, since reads may still finish while static objects are destroyed at 
+ * exit.
+ */
+static Threadpool & fileIoPool()
+{
+    static Threadpool *pool = new Threadpool(AsyncFileRead::FILE_IO_THREADS);
+    return *pool;
+}
+
+AsyncFileRead::AsyncFileRead(int fd, uint8_t *buffer, size_t bufferLength, off_t offset, size_t readAhead)
+    : fd{fd}, buffer{buffer}, bufferLength{bufferLength}, offset{offset}, readAhead{readAhead}
+{ }
+
+bool AsyncFileRead::tryReadCached()
+{
+#ifdef RWF_NOWAIT
+    iovec iov{buffer, bufferLength};
+
+    while (true)
+    {
+        ssize_t n = preadv2(fd, &iov, 1, offset, RWF_NOWAIT);
+
+        if (n < 0 && errno == EINTR) continue;
+
+        // EAGAIN if the data would have to come from the disk. Older kernels don't 
+        // support the flag, then every read goes to the I/O threads
+        if (n < 0) return false;
+
+        bytesRead = n;
+        return true;
+    }
+#else
+    return false;
+#endif
+}
+
+bool AsyncFileRead::await_ready()
+{
+    if (bufferLength == 0) return true;
+
+    // Copying a chunk from the page cache would hold up every other connection of 
+    // the loop thread, so once the coroutine runs there all reads go to the I/O threads
+    return !IoLoop::getDefault().isLoopThread() && tryReadCached();
+}
+
+void AsyncFileRead::await_suspend(std::coroutine_handle<> h)
+{
+    handle = h;
+
+    fileIoPool().addTask([this]() {
+        ssize_t n;
+
+        do
+        {
+            n = pread(fd, buffer, bufferLength, offset);
+        } while (n < 0 && errno == EINTR);
+
+        bytesRead = n;
+
+        if (n > 0 && readAhead > 0)
+            posix_fadvise(fd, offset + n, readAhead, POSIX_FADV_WILLNEED);
+
+        // Resume on the loop thread, so the I/O threads only ever wait for the disk
+        IoLoop::getDefault().waitUntil(std::chrono::steady_clock::now(), this);
+    });
+}
+
+size_t AsyncFileRead::await_resume()
+{
+    if (bytesRead < 0)
+    {
+        throw HttpException(HttpException::FileRead);
+    }
+
+    return bytesRead;
+}
+
+void AsyncFileRead::onReady()
+{
+    handle.resume();
+}
+
+
+AsyncSleep::AsyncSleep(std::chrono::steady_clock::time_point deadline)
+    : deadline{deadline}
+{ }
+
+bool AsyncSleep::await_ready()
+{
+    return deadline <= std::chrono::steady_clock::now();
+}
+
+void AsyncSleep::await_suspend(std::coroutine_handle<> h)
+{
+    handle = h;
+    IoLoop::getDefault().waitUntil(deadline, this);
+}
+
+void AsyncSleep::onReady()
+{
+    handle.resume();
+}
@@ -0,0 +1,111 @@
+#include "buffer_pool.hpp"
+
+#include <mutex>
+#include <utility>
+
+/**
+ * @brief A free buffer. The link is stored in the memory of the buffer itself.
+ */
+struct FreeBuffer
+{
+    FreeBuffer *next;
+};
+
+/**
+ * @brief The free buffers of all threads. The lock is only taken once per
+ * response, not per chunk.
+ */
+struct FreeBufferList
+{
+    std::mutex mtx;
+
+    /**
+     * @brief NOTE: The access is not synchronized by default and the mtx mutex must
+     * be used to access this variable.
+     */
+    FreeBuffer *head = nullptr;
+
+    size_t count = 0;
+};
+
+/**
+ * @brief The list is never destroyed, since buffers may still be returned while
+ * static objects are destroyed at exit.
+ */
+static FreeBufferList & freeBuffers()
+{
+    static FreeBufferList *list = new FreeBufferList();
+    return *list;
+}
+
+
+BufferPool::Buffer::Buffer(uint8_t *memory)
+    : memory{memory}
+{ }
+
+BufferPool::Buffer::Buffer(Buffer &&other)
+    : memory{std::exchange(other.memory, nullptr)}
+{ }
+
+BufferPool::Buffer & BufferPool::Buffer::operator=(Buffer &&other)
+{
+    if (&other != this)
+    {
+        if (memory) release(memory);
+        memory = std::exchange(other.memory, nullptr);
+    }
+    return *this;
+}
+
+BufferPool::Buffer::~Buffer()
+{
+    if (memory) release(memory);
+}
+
+uint8_t * BufferPool::Buffer::data() const
+{
+    return memory;
+}
+
+size_t BufferPool::Buffer::size() const
+{
+    return BUFFER_SIZE;
+}
+
+BufferPool::Buffer BufferPool::acquire()
+{
+    FreeBufferList &list = freeBuffers();
+
+    {
+        std::lock_guard<std::mutex> lock(list.mtx);
+
+        if (FreeBuffer *buffer = list.head)
+        {
+            list.head = buffer->next;
+            list.count--;
+            return Buffer(reinterpret_cast<uint8_t*>(buffer));
+        }
+    }
+
+    return Buffer(static_cast<uint8_t*>(::operator new(BUFFER_SIZE)));
+}
+
+void BufferPool::release(uint8_t *memory)
+{
+    FreeBufferList &list = freeBuffers();
+
+    {
+        std::lock_guard<std::mutex> lock(list.mtx);
+
+        if (list.count < MAX_FREE_BUFFERS)
+        {
+            FreeBuffer *buffer = reinterpret_cast<FreeBuffer*>(memory);
+            buffer->next = list.head;
+            list.head = buffer;
+            list.count++;
+            return;
+        }
+    }
+
+    ::operator delete(memory);
+}
@@ -0,0 +1,194 @@
+#include "cpu_topology.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+#include <sched.h>
+
+static const std::string SYSFS_CPU_DIR = "/sys/devices/system/cpu/";
+static const std::string SYSFS_NODE_DIR = "/sys/devices/system/node/";
+
+std::vector<int> CpuTopology::parseCpuList(const std::string &list)
+{
+    std::vector<int> result;
+    std::stringstream ss(list);
+    std::string range;
+
+    while (std::getline(ss, range, ','))
+    {
+        if (range.empty() || range == "\n") continue;
+
+        try
+        {
+            auto dash = range.find('-');
+
+            if (dash == std::string::npos)
+            {
+                result.push_back(std::stoi(range));
+                continue;
+            }
+
+            int first = std::stoi(range.substr(0, dash));
+            int last = std::stoi(range.substr(dash + 1));
+
+            for (int i = first; i <= last; i++)
+                result.push_back(i);
+        }
+        catch (const std::exception &e)
+        {
+            // Ignore malformed entries, the list comes from the kernel
+        }
+    }
+
+    return result;
+}
+
+int CpuTopology::readInt(const std::string &path, int fallback)
+{
+    std::ifstream file(path);
+    int value;
+
+    if (!(file >> value))
+        return fallback;
+
+    return value;
+}
+
+CpuTopology CpuTopology::discover()
+{
+    CpuTopology topology;
+
+    std::string online;
+    std::ifstream onlineFile(SYSFS_CPU_DIR + "online");
+    std::getline(onlineFile, online);
+
+    std::vector<int> ids = parseCpuList(online);
+
+    // Only use the cpus the process is allowed to run on (e.g. inside a cpuset 
+    // limited container)
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+    {
+        ids.erase(
+            std::remove_if(ids.begin(), ids.end(), [&allowed](int id) {
+                return id >= CPU_SETSIZE || !CPU_ISSET(id, &allowed);
+            }),
+            ids.end()
+        );
+    }
+
+    if (ids.empty())
+    {
+        // No sysfs, assume every logical cpu is a physical core on node 0
+        int n = std::max(1u, std::thread::hardware_concurrency());
+        for (int i = 0; i < n; i++)
+            topology.cpus.push_back(Cpu{i, i, 0, 0});
+
+        topology.nodes.push_back(0);
+        return topology;
+    }
+
+    for (int id : ids)
+    {
+        std::string dir = SYSFS_CPU_DIR + "cpu" + std::to_string(id) + "/topology/";
+
+        topology.cpus.push_back(Cpu{
+            id,
+            readInt(dir + "core_id", id),
+            readInt(dir + "physical_package_id", 0),
+            0
+        });
+    }
+
+    // Assign the NUMA nodes. Without NUMA support all cpus stay on node 0
+    std::set<int> nodes;
+
+    for (int node = 0; ; node++)
+    {
+        std::ifstream cpulistFile(SYSFS_NODE_DIR + "node" + std::to_string(node) + "/cpulist");
+
+        if (!cpulistFile)
+        {
+            // Node ids are usually contiguous, but allow for a few gaps
+            if (node > 64) break;
+            continue;
+        }
+
+        std::string cpulist;
+        std::getline(cpulistFile, cpulist);
+
+        for (int id : parseCpuList(cpulist))
+        {
+            for (auto &cpu : topology.cpus)
+            {
+                if (cpu.id == id)
+                {
+                    cpu.node = node;
+                    nodes.insert(node);
+                }
+            }
+        }
+    }
+
+    if (nodes.empty()) nodes.insert(0);
+
+    topology.nodes.assign(nodes.begin(), nodes.end());
+
+    return topology;
+}
+
+const std::vector<CpuTopology::Cpu> & CpuTopology::getCpus() const
+{
+    return cpus;
+}
+
+const std::vector<int> & CpuTopology::getNodes() const
+{
+    return nodes;
+}
+
+std::vector<int> CpuTopology::getCpusOfNode(int node) const
+{
+    std::vector<int> result;
+
+    for (const auto &cpu : cpus)
+    {
+        if (cpu.node == node)
+            result.push_back(cpu.id);
+    }
+
+    return result;
+}
+
+std::vector<int> CpuTopology::getPhysicalCores(int node) const
+{
+    std::vector<int> result;
+    std::set<std::pair<int, int>> seenCores;
+
+    for (const auto &cpu : cpus)
+    {
+        if (node != -1 && cpu.node != node)
+            continue;
+
+        // The first logical cpu of every (package, core) pair represents the core
+        if (seenCores.insert({cpu.package, cpu.core}).second)
+            result.push_back(cpu.id);
+    }
+
+    return result;
+}
+
+int CpuTopology::getNodeOfCpu(int cpu) const
+{
+    for (const auto &c : cpus)
+    {
+        if (c.id == cpu)
+            return c.node;
+    }
+
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include "event_count.hpp"
+
+#include <chrono>
+#include <climits>
+
+#include "futex.hpp"
+
+uint32_t EventCount::prepareWait()
+{
+    waiters.fetch_add(1, std::memory_order_seq_cst);
+    return epoch.load(std::memory_order_seq_cst);
+}
+
+void EventCount::cancelWait()
+{
+    waiters.fetch_sub(1, std::memory_order_seq_cst);
+}
+
+void EventCount::wait(uint32_t key)
+{
+    while (epoch.load(std::memory_order_acquire) == key)
+    {
+        futexWait(&epoch, key);
+    }
+
+    waiters.fetch_sub(1, std::memory_order_seq_cst);
+}
+
+bool EventCount::timedWait(uint32_t key, long ms)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+
+    while (epoch.load(std::memory_order_acquire) == key)
+    {
+        auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            deadline - std::chrono::steady_clock::now()
+        ).count();
+
+        if (remaining <= 0)
+        {
+            waiters.fetch_sub(1, std::memory_order_seq_cst);
+            return false;
+        }
+
+        timespec ts;
+        ts.tv_sec = remaining / 1000000000L;
+        ts.tv_nsec = remaining % 1000000000L;
+
+        futexWait(&epoch, key, &ts);
+    }
+
+    waiters.fetch_sub(1, std::memory_order_seq_cst);
+    return true;
+}
+
+void EventCount::notifyOne()
+{
+    notifyMany(1);
+}
+
+void EventCount::notifyMany(int count)
+{
+    // Order the change of the condition before the check for waiters. This pairs
+    // with the seq_cst increment in prepareWait()
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (count <= 0 || waiters.load(std::memory_order_relaxed) == 0)
+    {
+        return;
+    }
+
+    epoch.fetch_add(1, std::memory_order_seq_cst);
+    futexWake(&epoch, count);
+}
+
+void EventCount::notifyAll()
+{
+    notifyMany(INT_MAX);
+}
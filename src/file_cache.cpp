@@ -0,0 +1,246 @@
+#include "file_cache.hpp"
+
+#include <cstdio>
+#include <functional>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+CachedFile::CachedFile(std::vector<uint8_t> &&content, std::string_view contentType, std::string_view etag)
+    : content{std::move(content)}, type{contentType}, tag{etag}
+{ }
+
+CachedFile::CachedFile(std::shared_ptr<const MappedFile> mapping, std::string_view contentType, std::string_view etag)
+    : mapping{std::move(mapping)}, type{contentType}, tag{etag}
+{ }
+
+std::shared_ptr<const CachedFile> CachedFile::load(int fd, const struct stat &st, 
+    std::string_view contentType, bool map)
+{
+    size_t size = st.st_size;
+
+    if (map && size >= MIN_MAPPED_SIZE)
+    {
+        auto mapping = MappedFile::fromDescriptor(fd, st);
+        if (!mapping) return nullptr;
+
+        return std::make_shared<const CachedFile>(std::move(mapping), contentType, makeETag(st));
+    }
+
+    std::vector<uint8_t> content(size);
+
+    size_t offset = 0;
+
+    while (offset < size)
+    {
+        ssize_t bytes_read = pread(fd, content.data() + offset, size - offset, offset);
+
+        if (bytes_read <= 0)
+            return nullptr;
+
+        offset += bytes_read;
+    }
+
+    return std::make_shared<const CachedFile>(std::move(content), contentType, makeETag(st));
+}
+
+std::shared_ptr<const CachedFile> CachedFile::load(const std::string &path, 
+    std::string_view contentType, bool map)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0)
+        return nullptr;
+
+    std::shared_ptr<const CachedFile> file;
+
+    struct stat st;
+
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+        file = load(fd, st, contentType, map);
+
+    close(fd);
+
+    return file;
+}
+
+std::string CachedFile::makeETag(const struct stat &st)
+{
+    // Same scheme as nginx, but with nanoseconds so quick rewrites get a new tag
+    char etag[64];
+    snprintf(etag, sizeof(etag), "\"%llx.%lx-%llx\"", 
+        (unsigned long long)st.st_mtim.tv_sec, (unsigned long)st.st_mtim.tv_nsec, 
+        (unsigned long long)st.st_size);
+
+    return etag;
+}
+
+const uint8_t * CachedFile::data() const
+{
+    return mapping ? mapping->data() : content.data();
+}
+
+size_t CachedFile::size() const
+{
+    return mapping ? mapping->size() : content.size();
+}
+
+bool CachedFile::isUnchanged() const
+{
+    return !mapping || mapping->isUnchanged();
+}
+
+const std::string & CachedFile::contentType() const
+{
+    return type;
+}
+
+const std::string & CachedFile::etag() const
+{
+    return tag;
+}
+
+bool CachedFile::matchesETag(std::string_view ifNoneMatch, std::string_view etag)
+{
+    // The header is a comma separated list of tags, or *
+    while (!ifNoneMatch.empty())
+    {
+        size_t end = ifNoneMatch.find(',');
+        std::string_view candidate = ifNoneMatch.substr(0, end);
+        ifNoneMatch = end == std::string_view::npos ? std::string_view{} : ifNoneMatch.substr(end + 1);
+
+        while (!candidate.empty() && candidate.front() == ' ') candidate.remove_prefix(1);
+        while (!candidate.empty() && candidate.back() == ' ') candidate.remove_suffix(1);
+
+        // Weak comparison, as required for If-None-Match
+        if (candidate.substr(0, 2) == "W/") candidate.remove_prefix(2);
+
+        if (candidate == "*" || candidate == etag)
+            return true;
+    }
+
+    return false;
+}
+
+
+FileCache::FileCache(size_t capacityBytes, size_t maxFileSize)
+    : shardCapacity{capacityBytes / NUMBER_OF_SHARDS}, maxFileSize{maxFileSize}
+{ }
+
+FileCache::Shard & FileCache::shardOf(std::string_view path)
+{
+    return shards[std::hash<std::string_view>{}(path) % NUMBER_OF_SHARDS];
+}
+
+void FileCache::eraseEntry(Shard &shard, LruList::iterator entry)
+{
+    shard.bytes -= entry->second->size();
+    shard.index.erase(entry->first);
+    shard.lru.erase(entry);
+}
+
+std::shared_ptr<const CachedFile> FileCache::get(std::string_view path)
+{
+    Shard &shard = shardOf(path);
+
+    std::lock_guard<std::mutex> lock(shard.mtx);
+
+    auto it = shard.index.find(path);
+
+    if (it == shard.index.end())
+        return nullptr;
+
+    // Move the entry to the front, the node and its key stay valid
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+
+    return it->second->second;
+}
+
+bool FileCache::admits(size_t fileSize) const
+{
+    return fileSize <= maxFileSize && fileSize <= shardCapacity;
+}
+
+bool FileCache::put(std::string_view path, std::shared_ptr<const CachedFile> file)
+{
+    if (!admits(file->size()))
+        return false;
+
+    Shard &shard = shardOf(path);
+
+    // The evicted files are released after the lock, the last reference may free 
+    // a lot of memory
+    LruList evicted;
+
+    {
+        std::lock_guard<std::mutex> lock(shard.mtx);
+
+        auto it = shard.index.find(path);
+
+        if (it != shard.index.end())
+        {
+            shard.bytes -= it->second->second->size();
+            shard.index.erase(it->second->first);
+            evicted.splice(evicted.end(), shard.lru, it->second);
+        }
+
+        while (!shard.lru.empty() && shard.bytes + file->size() > shardCapacity)
+        {
+            auto last = std::prev(shard.lru.end());
+
+            shard.bytes -= last->second->size();
+            shard.index.erase(last->first);
+            evicted.splice(evicted.end(), shard.lru, last);
+        }
+
+        shard.lru.emplace_front(std::string(path), std::move(file));
+        shard.index.emplace(shard.lru.front().first, shard.lru.begin());
+        shard.bytes += shard.lru.front().second->size();
+    }
+
+    return true;
+}
+
+void FileCache::erase(std::string_view path)
+{
+    Shard &shard = shardOf(path);
+
+    std::shared_ptr<const CachedFile> released;
+
+    std::lock_guard<std::mutex> lock(shard.mtx);
+
+    auto it = shard.index.find(path);
+
+    if (it != shard.index.end())
+    {
+        released = it->second->second;
+        eraseEntry(shard, it->second);
+    }
+}
+
+void FileCache::clear()
+{
+    for (auto &shard : shards)
+    {
+        LruList released;
+
+        std::lock_guard<std::mutex> lock(shard.mtx);
+
+        released.swap(shard.lru);
+        shard.index.clear();
+        shard.bytes = 0;
+    }
+}
+
+size_t FileCache::getCachedBytes()
+{
+    size_t bytes = 0;
+
+    for (auto &shard : shards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        bytes += shard.bytes;
+    }
+
+    return bytes;
+}
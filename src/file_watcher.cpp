@@ -0,0 +1,245 @@
+#include "file_watcher.hpp"
+
+#include <stdexcept>
+
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+/**
+ * @brief The events that can change what a path in the directory refers to.
+ */
+static const uint32_t WATCH_EVENTS = IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB | IN_CREATE | IN_DELETE 
+    | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+
+FileWatcher::FileWatcher(IoLoop &loop)
+    : loop{loop}
+{
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0)
+    {
+        throw std::runtime_error("FileWatcher failed to create the inotify instance");
+    }
+
+    loop.waitFd(inotifyFd, EPOLLIN, this);
+}
+
+FileWatcher::~FileWatcher()
+{
+    close(inotifyFd);
+}
+
+FileWatcher & FileWatcher::getDefault()
+{
+    static FileWatcher *watcher = new FileWatcher();
+    return *watcher;
+}
+
+void FileWatcher::addCallback(std::vector<OwnedCallback> &callbacks, OwnedCallback callback)
+{
+    if (callback.owner != nullptr)
+    {
+        for (auto &existing : callbacks)
+        {
+            if (existing.owner == callback.owner)
+            {
+                existing.callback = std::move(callback.callback);
+                return;
+            }
+        }
+    }
+
+    callbacks.push_back(std::move(callback));
+}
+
+bool FileWatcher::watchDirectory(const std::string &directory, Callback callback, const void *owner)
+{
+    int wd = inotify_add_watch(inotifyFd, directory.c_str(), WATCH_EVENTS | IN_ONLYDIR);
+
+    if (wd < 0)
+        return false;
+
+    std::lock_guard<std::mutex> lock(mtxWatches);
+
+    // Watching the same directory again returns the same descriptor
+    DirectoryWatch &watch = watches[wd];
+    watch.directory = directory;
+    addCallback(watch.callbacks, OwnedCallback{owner, std::move(callback)});
+
+    return true;
+}
+
+void FileWatcher::notify(int wd, std::string_view name)
+{
+    std::string directory;
+    std::vector<OwnedCallback> callbacks;
+
+    // The callbacks are called without the lock, so they can add watches
+    {
+        std::lock_guard<std::mutex> lock(mtxWatches);
+
+        auto it = watches.find(wd);
+        if (it == watches.end())
+            return;
+
+        directory = it->second.directory;
+        callbacks = it->second.callbacks;
+    }
+
+    for (const auto &callback : callbacks)
+    {
+        callback.callback(directory, name);
+    }
+}
+
+void FileWatcher::loseWatch(int wd)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtxWatches);
+
+        auto it = watches.find(wd);
+        if (it == watches.end())
+            return;
+
+        lostWatches.push_back(std::move(it->second));
+        watches.erase(it);
+    }
+
+    retryLostWatches();
+}
+
+void FileWatcher::retryLostWatches()
+{
+    std::vector<int> watchedAgain;
+    bool schedule = false;
+
+    {
+        std::lock_guard<std::mutex> lock(mtxWatches);
+
+        for (auto it = lostWatches.begin(); it != lostWatches.end(); )
+        {
+            int wd = inotify_add_watch(inotifyFd, it->directory.c_str(), WATCH_EVENTS | IN_ONLYDIR);
+
+            if (wd < 0)
+            {
+                ++it;
+                continue;
+            }
+
+            // The path may lead to a directory that is already watched
+            DirectoryWatch &watch = watches[wd];
+            watch.directory = it->directory;
+
+            for (auto &callback : it->callbacks)
+            {
+                addCallback(watch.callbacks, std::move(callback));
+            }
+
+            watchedAgain.push_back(wd);
+            it = lostWatches.erase(it);
+        }
+
+        if (!lostWatches.empty() && !retryScheduled)
+        {
+            retryScheduled = true;
+            schedule = true;
+        }
+    }
+
+    if (schedule)
+    {
+        loop.waitUntil(std::chrono::steady_clock::now() + RETRY_INTERVAL, &retryTimer);
+    }
+
+    // Nothing was reported while the directory wasn't watched
+    for (int wd : watchedAgain)
+    {
+        notify(wd, {});
+    }
+}
+
+void FileWatcher::RetryTimer::onReady()
+{
+    {
+        std::lock_guard<std::mutex> lock(watcher.mtxWatches);
+        watcher.retryScheduled = false;
+    }
+
+    watcher.retryLostWatches();
+}
+
+void FileWatcher::revalidateWatches()
+{
+    std::vector<int> moved;
+
+    {
+        std::lock_guard<std::mutex> lock(mtxWatches);
+
+        for (const auto &w : watches)
+        {
+            // Adding a watch for a watched directory returns its descriptor
+            if (inotify_add_watch(inotifyFd, w.second.directory.c_str(), WATCH_EVENTS | IN_ONLYDIR) != w.first)
+                moved.push_back(w.first);
+        }
+    }
+
+    for (int wd : moved)
+    {
+        inotify_rm_watch(inotifyFd, wd);
+        loseWatch(wd);
+    }
+}
+
+void FileWatcher::onReady()
+{
+    alignas(inotify_event) char buffer[16384];
+
+    ssize_t length;
+
+    while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0)
+    {
+        for (char *p = buffer; p < buffer + length; )
+        {
+            const inotify_event *event = reinterpret_cast<const inotify_event*>(p);
+            p += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                // Events were lost, every watched directory may have changed
+                std::vector<int> all;
+                {
+                    std::lock_guard<std::mutex> lock(mtxWatches);
+                    for (const auto &w : watches) all.push_back(w.first);
+                }
+
+                for (int wd : all) notify(wd, {});
+
+                // The events of deleted or moved directories may be lost as well
+                revalidateWatches();
+                continue;
+            }
+
+            if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+            {
+                notify(event->wd, {});
+
+                // A moved directory keeps its watch, but the path now leads to 
+                // another directory. Removing the watch makes the kernel send 
+                // IN_IGNORED, then the path is watched again
+                if (event->mask & IN_MOVE_SELF)
+                    inotify_rm_watch(inotifyFd, event->wd);
+
+                if (event->mask & IN_IGNORED)
+                    loseWatch(event->wd);
+
+                continue;
+            }
+
+            // The name is padded with null bytes
+            notify(event->wd, event->len > 0 ? std::string_view(event->name) : std::string_view{});
+        }
+    }
+
+    loop.waitFd(inotifyFd, EPOLLIN, this);
+}
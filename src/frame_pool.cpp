@@ -0,0 +1,165 @@
+#include "frame_pool.hpp"
+
+#include <mutex>
+#include <new>
+
+/**
+ * @brief A free frame. The link is stored in the memory of the frame itself.
+ */
+struct FreeFrame
+{
+    FreeFrame *next;
+};
+
+static const size_t NUMBER_OF_CLASSES = FramePool::MAX_POOLED_SIZE / FramePool::SIZE_CLASS_STEP;
+
+/**
+ * @brief The free lists of the calling thread. The frames are released to the 
+ * heap when the thread exits.
+ */
+struct FreeLists
+{
+    FreeFrame *heads[NUMBER_OF_CLASSES] = {};
+
+    size_t counts[NUMBER_OF_CLASSES] = {};
+
+    ~FreeLists()
+    {
+        for (size_t i = 0; i < NUMBER_OF_CLASSES; i++)
+        {
+            while (heads[i])
+            {
+                FreeFrame *frame = heads[i];
+                heads[i] = frame->next;
+                ::operator delete(frame);
+            }
+        }
+    }
+};
+
+static thread_local FreeLists freeLists;
+
+/**
+ * @brief The maximum number of frames taken from the shared list at once.
+ */
+static const size_t SHARED_REFILL_BATCH = 16;
+
+/**
+ * @brief Frames that didn't fit into the free list of the thread that freed them. 
+ * Frames of suspended coroutines are usually allocated on a worker but freed on 
+ * the IoLoop thread, this is how they get back to the workers.
+ */
+struct SharedFreeLists
+{
+    std::mutex mtx;
+
+    /**
+     * @brief NOTE: The access is not synchronized by default and the mtx mutex must
+     * be used to access this variable.
+     */
+    FreeFrame *heads[NUMBER_OF_CLASSES] = {};
+
+    /**
+     * @brief NOTE: The access is not synchronized by default and the mtx mutex must
+     * be used to access this variable.
+     */
+    size_t counts[NUMBER_OF_CLASSES] = {};
+};
+
+/**
+ * @brief The lists are never destroyed, since frames may still be freed while 
+ * static objects are destroyed at exit.
+ */
+static SharedFreeLists & sharedFreeLists()
+{
+    static SharedFreeLists *lists = new SharedFreeLists();
+    return *lists;
+}
+
+static size_t sizeClassOf(size_t size)
+{
+    return (size + FramePool::SIZE_CLASS_STEP - 1) / FramePool::SIZE_CLASS_STEP - 1;
+}
+
+
+void * FramePool::allocate(size_t size)
+{
+    if (size > MAX_POOLED_SIZE)
+        return ::operator new(size);
+
+    size_t cls = sizeClassOf(size);
+    FreeFrame *frame = freeLists.heads[cls];
+
+    if (frame)
+    {
+        freeLists.heads[cls] = frame->next;
+        freeLists.counts[cls]--;
+        return frame;
+    }
+
+    // Move a batch of frames from the shared list, so the lock is not taken for 
+    // every frame
+    {
+        SharedFreeLists &shared = sharedFreeLists();
+        std::lock_guard<std::mutex> lock(shared.mtx);
+
+        if (FreeFrame *first = shared.heads[cls])
+        {
+            shared.heads[cls] = first->next;
+            shared.counts[cls]--;
+
+            for (size_t i = 1; i < SHARED_REFILL_BATCH && shared.heads[cls]; i++)
+            {
+                FreeFrame *moved = shared.heads[cls];
+                shared.heads[cls] = moved->next;
+                shared.counts[cls]--;
+
+                moved->next = freeLists.heads[cls];
+                freeLists.heads[cls] = moved;
+                freeLists.counts[cls]++;
+            }
+
+            return first;
+        }
+    }
+
+    // Allocate the full size class, so the frame can be reused for any size of it
+    return ::operator new((cls + 1) * SIZE_CLASS_STEP);
+}
+
+void FramePool::deallocate(void *frame, size_t size)
+{
+    if (size > MAX_POOLED_SIZE)
+    {
+        ::operator delete(frame);
+        return;
+    }
+
+    size_t cls = sizeClassOf(size);
+
+    FreeFrame *freeFrame = static_cast<FreeFrame*>(frame);
+
+    if (freeLists.counts[cls] >= MAX_FREE_PER_CLASS)
+    {
+        SharedFreeLists &shared = sharedFreeLists();
+
+        {
+            std::lock_guard<std::mutex> lock(shared.mtx);
+
+            if (shared.counts[cls] < MAX_SHARED_FREE_PER_CLASS)
+            {
+                freeFrame->next = shared.heads[cls];
+                shared.heads[cls] = freeFrame;
+                shared.counts[cls]++;
+                return;
+            }
+        }
+
+        ::operator delete(frame);
+        return;
+    }
+
+    freeFrame->next = freeLists.heads[cls];
+    freeLists.heads[cls] = freeFrame;
+    freeLists.counts[cls]++;
+}
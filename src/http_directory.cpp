@@ -0,0 +1,326 @@
+#include "http_directory.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "buffer_pool.hpp"
+#include "file_cache.hpp"
+#include "file_watcher.hpp"
+#include "mime_types.hpp"
+#include "open_file_cache.hpp"
+
+/**
+ * @brief Count the non empty segments of a path.
+ */
+static size_t countSegments(std::string_view path)
+{
+    size_t count = 0;
+    bool inSegment = false;
+
+    for (char c : path)
+    {
+        if (c != '/' && !inSegment) count++;
+        inSegment = c != '/';
+    }
+
+    return count;
+}
+
+/**
+ * @brief Build the file path for the request from the decoded path segments behind
+ * the prefix.
+ * 
+ * @return False if the path tries to leave the root directory.
+ */
+static bool resolveFilePath(const HttpRequest &req, size_t prefixSegments, const std::string &root, 
+    std::string &filePath)
+{
+    const auto &segments = req.pathSegments();
+
+    filePath = root;
+
+    for (size_t i = prefixSegments; i < segments.size(); i++)
+    {
+        std::string_view segment = segments[i];
+
+        if (segment == ".")
+            continue;
+
+        // Decoded slashes and null bytes could also be used to escape the root
+        if (segment == ".." || segment.find('/') != std::string_view::npos 
+            || segment.find('\0') != std::string_view::npos)
+        {
+            return false;
+        }
+
+        filePath += '/';
+        filePath += segment;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Open the regular file at filePath, or the index file if it is a directory.
+ * 
+ * @param beforeOpen Called with every path before it is opened.
+ * 
+ * @return The file descriptor or -1 if there is no such regular file.
+ */
+template <typename BeforeOpen>
+static int openRegularFile(std::string &filePath, const std::string &indexFile, struct stat &st, 
+    BeforeOpen &&beforeOpen)
+{
+    beforeOpen(filePath);
+
+    int fd = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0)
+        return -1;
+
+    if (fstat(fd, &st) == 0 && S_ISDIR(st.st_mode) && !indexFile.empty())
+    {
+        close(fd);
+
+        filePath += '/';
+        filePath += indexFile;
+
+        beforeOpen(filePath);
+
+        fd = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+
+        if (fd < 0)
+            return -1;
+
+        if (fstat(fd, &st) != 0)
+            st.st_mode = 0;
+    }
+
+    if (!S_ISREG(st.st_mode))
+    {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/**
+ * @brief Send the head for a file, or a 304 Not Modified head if the client 
+ * already has the file with this ETag.
+ * 
+ * @return True if the body has to be sent.
+ */
+static bool sendFileHead(const HttpRequest &req, HttpResponse &res, std::string_view contentType, size_t size, 
+    const std::string &etag, const std::vector<HttpHeader> &setHeaders)
+{
+    HttpHeaders &headers = res.getHeadersWritable();
+
+    headers.setHeader(HeaderId::ETag, etag);
+
+    for (const auto &h : setHeaders)
+    {
+        headers.setHeader(h.getKey(), h.getValue());
+    }
+
+    if (CachedFile::matchesETag(req.headers().getValueOrEmpty(HeaderId::IfNoneMatch), etag))
+    {
+        res.setStatus(304, "Not Modified");
+        headers.unsetHeader(HeaderId::ContentType);
+        res.sendHeader();
+        return false;
+    }
+
+    headers.setHeader(HeaderId::ContentType, contentType);
+    headers.setHeader(HeaderId::ContentLength, std::to_string(size));
+
+    res.sendHeader();
+
+    return req.method() != "HEAD";
+}
+
+/**
+ * @brief The state shared by all copies of a directory route and its watcher 
+ * callbacks.
+ */
+struct DirectoryState
+{
+    FileCache cache;
+
+    std::mutex mtxWatched;
+
+    /**
+     * @brief The directories whose changes invalidate cache entries.
+     * 
+     * NOTE: The access is not synchronized by default and the mtxWatched mutex must 
+     * be used to access this variable.
+     */
+    std::unordered_set<std::string> watched;
+
+    DirectoryState(size_t cacheBytes, size_t maxCachedFileSize)
+        : cache{cacheBytes, maxCachedFileSize}
+    { }
+};
+
+/**
+ * @brief Make sure that changes in the directory of a cached file invalidate its 
+ * cache entries.
+ */
+static void watchDirectoryOf(const std::shared_ptr<DirectoryState> &state, const std::string &filePath, 
+    const std::string &indexFile)
+{
+    std::string directory = filePath.substr(0, filePath.rfind('/'));
+
+    {
+        std::lock_guard<std::mutex> lock(state->mtxWatched);
+
+        if (!state->watched.insert(directory).second)
+            return;
+    }
+
+    std::weak_ptr<DirectoryState> weakState = state;
+
+    bool watching = FileWatcher::getDefault().watchDirectory(directory, 
+        [weakState, indexFile](const std::string &dir, std::string_view name) {
+            auto state = weakState.lock();
+            if (!state) return;
+
+            if (name.empty())
+            {
+                // Anything may have changed, so start over. Watching the directory 
+                // again replaces this callback
+                state->cache.clear();
+
+                std::lock_guard<std::mutex> lock(state->mtxWatched);
+                state->watched.erase(dir);
+                return;
+            }
+
+            std::string path = dir + "/" + std::string(name);
+
+            // The path may be a file or a directory that is cached with its index
+            state->cache.erase(path);
+            if (name == indexFile) state->cache.erase(dir);
+        },
+        state.get()
+    );
+
+    if (!watching)
+    {
+        std::lock_guard<std::mutex> lock(state->mtxWatched);
+        state->watched.erase(directory);
+    }
+}
+
+HttpRoute serveDirectory(const std::string &prefix, const std::string &root, const DirectoryOptions &options)
+{
+    auto state = std::make_shared<DirectoryState>(options.cacheBytes, options.maxCachedFileSize);
+
+    size_t prefixSegments = countSegments(prefix);
+
+    return HttpRoute(
+        prefix,
+        [state, prefix, prefixSegments, root, options] (HttpRequest &req, HttpResponse &res) -> HttpTask {
+
+            // "/assets" must not match "/assetsfoo"
+            std::string_view path = req.path();
+
+            if (!prefix.empty() && prefix.back() != '/' && path.size() > prefix.size() && path[prefix.size()] != '/')
+                co_return HttpRouteHandling::Continue;
+
+            std::string filePath;
+
+            if (!resolveFilePath(req, prefixSegments, root, filePath))
+            {
+                res.sendDefault404();
+                co_return HttpRouteHandling::End;
+            }
+
+            std::shared_ptr<const CachedFile> file = state->cache.get(filePath);
+
+            if (file && !file->isUnchanged())
+            {
+                // A mapped file was rewritten in place and the watcher hasn't 
+                // reported it yet
+                state->cache.erase(filePath);
+                file = nullptr;
+            }
+
+            if (!file)
+            {
+                // Directories are cached under their own path, not the index file
+                std::string cacheKey = filePath;
+
+                // Watch before opening, so a change after the file was read is not 
+                // missed. Otherwise the outdated content could stay in the cache
+                struct stat st;
+                int fd = openRegularFile(filePath, options.indexFile, st, [&state, &options](const std::string &path) {
+                    watchDirectoryOf(state, path, options.indexFile);
+                });
+
+                if (fd < 0)
+                {
+                    res.sendDefault404();
+                    co_return HttpRouteHandling::End;
+                }
+
+                size_t size = st.st_size;
+
+                if (!state->cache.admits(size))
+                {
+                    // Stream large files without caching them. The reads don't block 
+                    // the worker, and the descriptor is closed on errors as well
+                    OpenFile file(fd, st);
+
+                    if (!sendFileHead(req, res, mimeTypeForPath(filePath), size, file.etag(), options.setHeaders))
+                        co_return HttpRouteHandling::End;
+
+                    // Not part of the frame, which then stays small enough for FramePool
+                    BufferPool::Buffer buffer = BufferPool::acquire();
+                    size_t offset = 0;
+
+                    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+                    while (offset < size)
+                    {
+                        size_t length = std::min(buffer.size(), size - offset);
+
+                        size_t bytes_read = co_await AsyncFileRead(fd, buffer.data(), length, offset, buffer.size());
+
+                        if (bytes_read == 0)
+                            break;
+
+                        co_await res.write(buffer.data(), bytes_read);
+                        offset += bytes_read;
+                    }
+
+                    co_return HttpRouteHandling::End;
+                }
+
+                file = CachedFile::load(fd, st, mimeTypeForPath(filePath), options.mapFiles);
+
+                close(fd);
+
+                if (!file)
+                {
+                    res.sendDefault404();
+                    co_return HttpRouteHandling::End;
+                }
+
+                state->cache.put(cacheKey, file);
+            }
+
+            if (sendFileHead(req, res, file->contentType(), file->size(), file->etag(), options.setHeaders))
+                res.sendBody(file->data(), file->size());
+
+            co_return HttpRouteHandling::End;
+        },
+        HttpRoute::MatchType::StartsWith
+    );
+}
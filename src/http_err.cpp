@@ -39,6 +39,10 @@ const char * HttpException::typeToString(const HttpException::Type & type)
         return "HttpException::TcpAccept";
     case TcpSend:
         return "HttpException::TcpSend";
+    case TcpRecv:
+        return "HttpException::TcpRecv";
+    case FileRead:
+        return "HttpException::FileRead";
     }
 
     return "HttpException::NoType";
@@ -0,0 +1,24 @@
+#include "http_executor.hpp"
+
+HttpExecutor::HttpExecutor(int maxConcurrency, int maxQueued)
+    : pool{maxConcurrency, maxQueued}
+{ }
+
+bool HttpExecutor::trySubmit(Threadpool::Task &&task)
+{
+    if (pool.tryAddTask(std::move(task)))
+        return true;
+
+    rejectedRequests.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void HttpExecutor::submit(Threadpool::Task &&task)
+{
+    pool.addTask(std::move(task));
+}
+
+uint64_t HttpExecutor::getRejectedRequests() const
+{
+    return rejectedRequests.load(std::memory_order_relaxed);
+}
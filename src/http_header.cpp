@@ -1,5 +1,10 @@
 #include "http_header.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+
 const std::string HttpHeader::Authorization = "Authorization";
 
 const std::string HttpHeader::Connection = "Connection";
@@ -37,14 +42,127 @@ const std::string HttpHeader::TransferEncoding = "Transfer-Encoding";
 
 const std::string HttpHeader::Date = "Date";
 
+const std::string HttpHeader::ETag = "ETag";
+const std::string HttpHeader::IfNoneMatch = "If-None-Match";
+
+const std::string HttpHeader::CacheControl = "Cache-Control";
+
+
+/**
+ * @brief The names of the well known headers, indexed by HeaderId. These are
+ * literals so the hash table can be built at compile time.
+ */
+static constexpr std::string_view wellKnownNames[(size_t)HeaderId::Unknown] = {
+    "Authorization",
+    "Connection", "Keep-Alive",
+    "Accept", "Accept-Charset", "Accept-Encoding",
+    "Cookie", "Set-Cookie",
+    "Content-Disposition",
+    "Content-Length", "Content-Type", "Content-Encoding", "Content-Language", "Content-Location",
+    "Location",
+    "Host", "Referer", "User-Agent",
+    "Allow", "Server",
+    "Accept-Ranges", "Range", "Content-Range",
+    "Transfer-Encoding",
+    "Date",
+    "ETag", "If-None-Match",
+    "Cache-Control",
+};
+
+static const std::string * const wellKnownStrings[(size_t)HeaderId::Unknown] = {
+    &HttpHeader::Authorization,
+    &HttpHeader::Connection, &HttpHeader::KeepAlive,
+    &HttpHeader::Accept, &HttpHeader::AcceptCharset, &HttpHeader::AcceptEncoding,
+    &HttpHeader::Cookie, &HttpHeader::SetCookie,
+    &HttpHeader::ContentDisposition,
+    &HttpHeader::ContentLength, &HttpHeader::ContentType, &HttpHeader::ContentEncoding,
+    &HttpHeader::ContentLanguage, &HttpHeader::ContentLocation,
+    &HttpHeader::Location,
+    &HttpHeader::Host, &HttpHeader::Referer, &HttpHeader::UserAgent,
+    &HttpHeader::Allow, &HttpHeader::Server,
+    &HttpHeader::AcceptRanges, &HttpHeader::Range, &HttpHeader::ContentRange,
+    &HttpHeader::TransferEncoding,
+    &HttpHeader::Date,
+    &HttpHeader::ETag, &HttpHeader::IfNoneMatch,
+    &HttpHeader::CacheControl,
+};
+
+static const size_t ID_TABLE_SIZE = 64;
+
+/**
+ * @brief Hash a header name by its length and its first and last character.
+ * Setting bit 0x20 lowercases letters, other characters only have to hash
+ * consistently since the match is verified afterwards. The multipliers were
+ * chosen so the well known names don't collide in a table of 64.
+ */
+static constexpr size_t idHash(std::string_view name)
+{
+    size_t first = (uint8_t)name.front() | 0x20;
+    size_t last = (uint8_t)name.back() | 0x20;
+
+    return (name.size() * 9 + first + last * 15) & (ID_TABLE_SIZE - 1);
+}
+
+static constexpr std::array<HeaderId, ID_TABLE_SIZE> buildIdTable()
+{
+    std::array<HeaderId, ID_TABLE_SIZE> table{};
+
+    for (auto &id : table) id = HeaderId::Unknown;
+
+    for (size_t i = 0; i < (size_t)HeaderId::Unknown; i++)
+    {
+        table[idHash(wellKnownNames[i])] = (HeaderId)i;
+    }
+
+    return table;
+}
+
+static constexpr std::array<HeaderId, ID_TABLE_SIZE> idTable = buildIdTable();
+
+static constexpr bool idTableIsPerfect()
+{
+    for (size_t i = 0; i < (size_t)HeaderId::Unknown; i++)
+    {
+        if (idTable[idHash(wellKnownNames[i])] != (HeaderId)i)
+            return false;
+    }
+
+    return true;
+}
+
+static_assert(idTableIsPerfect(), "Well known header names collide in the id hash table");
+
+
+HeaderId HttpHeader::lookupId(std::string_view name)
+{
+    if (name.empty())
+        return HeaderId::Unknown;
+
+    HeaderId id = idTable[idHash(name)];
+
+    if (id == HeaderId::Unknown || !HttpHeaders::keyEquals(name, wellKnownNames[(size_t)id]))
+        return HeaderId::Unknown;
+
+    return id;
+}
+
+const std::string & HttpHeader::name(HeaderId id)
+{
+    return *wellKnownStrings[(size_t)id];
+}
+
 
 
 HttpHeader::HttpHeader()
-    : _isSet{false}
+    : _isSet{false}, id{HeaderId::Unknown}
 { }
 
-HttpHeader::HttpHeader(const std::string & key, const std::string & value)
-    : _isSet{true}, key{key}, value{value}
+HttpHeader::HttpHeader(std::string_view key, std::string_view value, std::pmr::memory_resource *resource)
+    : _isSet{true}, id{lookupId(key)}, key{key, resource}, value{value, resource}
+{ }
+
+HttpHeader::HttpHeader(HeaderId id, std::string_view value, std::pmr::memory_resource *resource)
+    : _isSet{true}, id{id}, key{wellKnownNames[(size_t)id], resource}, value{value, resource}
 { }
 
 const bool HttpHeader::isSet() const
@@ -52,26 +170,33 @@ const bool HttpHeader::isSet() const
     return _isSet;
 }
 
-const std::string & HttpHeader::getKey() const
+HeaderId HttpHeader::getId() const
+{
+    return id;
+}
+
+std::string_view HttpHeader::getKey() const
 {
     return key;
 }
 
-const std::string & HttpHeader::getValue() const
+std::string_view HttpHeader::getValue() const
 {
     return value;
 }
 
 
-void HttpHeader::setKey(const std::string & _key)
+void HttpHeader::setKey(std::string_view _key)
 {
     key = _key;
 
     // Convert key to lowercase to ensure case insensitivity
     for (auto &c : key) c = tolower(c);
+
+    id = lookupId(key);
 }
 
-void HttpHeader::setValue(const std::string & _value)
+void HttpHeader::setValue(std::string_view _value)
 {
     value = _value;
 }
@@ -84,80 +209,294 @@ void HttpHeader::setValue(const std::string & _value)
 
 const HttpHeader HttpHeaders::emptyHeader{};
 
-const std::string HttpHeaders::emptyString{};
 
+HttpHeaders::HttpHeaders(std::pmr::memory_resource *resource)
+    : resource{resource}
+{ }
 
-const HttpHeader & HttpHeaders::getHeader(const std::string & key) const
+HttpHeaders::HttpHeaders(const HttpHeaders & other)
+    : _headers{other._headers}, resource{std::pmr::get_default_resource()}
 {
-    std::string key_lower = key;
-    for (auto &c : key_lower) c = std::tolower(c);
+    std::copy(std::begin(other.slots), std::end(other.slots), std::begin(slots));
+}
 
-    auto h = _headers.find(key_lower);
-    if (h == _headers.end())
+HttpHeaders & HttpHeaders::operator=(const HttpHeaders & other)
+{
+    if (&other != this)
     {
-        return HttpHeaders::emptyHeader;
+        _headers.clear();
+
+        // Copy into the own resource instead of the one of other
+        for (const auto &h : other._headers)
+        {
+            _headers.emplace_back(h.key, h.value, resource);
+        }
+
+        std::copy(std::begin(other.slots), std::end(other.slots), std::begin(slots));
     }
-    
-    return (*h).second;
+    return *this;
+}
 
+std::pmr::memory_resource * HttpHeaders::getResource() const
+{
+    return resource;
 }
 
-const std::string & HttpHeaders::getValueOrEmpty(const std::string & key) const
+
+/**
+ * @brief Convert the ASCII upper case letters in the 8 bytes of word to lower
+ * case. Bytes >= 0x80 are left untouched.
+ */
+static inline uint64_t lowerWord(uint64_t word)
 {
-    const HttpHeader & h = getHeader(key);
-    if (!h._isSet) return HttpHeaders::emptyString;
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t high = 0x8080808080808080ULL;
+
+    // With the high bit cleared, adding to a byte never carries into the next
+    // byte. The high bit of the sum then tells if the byte was >= 'A' or > 'Z'
+    uint64_t low7 = word & ~high;
+    uint64_t geA = low7 + (0x80 - 'A') * ones;
+    uint64_t gtZ = low7 + (0x80 - 'Z' - 1) * ones;
+
+    uint64_t upper = geA & ~gtZ & ~word & high;
 
-    return h.getValue();
+    // 0x80 >> 2 is 0x20, the difference between upper and lower case
+    return word | (upper >> 2);
 }
 
-const std::unordered_map<std::string, HttpHeader> & HttpHeaders::getRawHeaders() const
+static inline uint8_t lowerByte(uint8_t c)
 {
-    return _headers;
+    return (c >= 'A' && c <= 'Z') ? c | 0x20 : c;
 }
 
-const bool HttpHeaders::headerExists(const std::string & key) const
+bool HttpHeaders::keyEquals(std::string_view a, std::string_view b)
 {
-    std::string key_lower = key;
+    if (a.size() != b.size())
+        return false;
 
-    for (auto &c : key_lower) c = std::tolower(c);
+    const char *pa = a.data();
+    const char *pb = b.data();
+    size_t length = a.size();
 
-    auto h = _headers.find(key_lower);
+    size_t i = 0;
 
-    if (h == _headers.end())
+    for (; i + 8 <= length; i += 8)
     {
-        return false;
+        uint64_t wa, wb;
+        std::memcpy(&wa, pa + i, 8);
+        std::memcpy(&wb, pb + i, 8);
+
+        if (wa != wb && lowerWord(wa) != lowerWord(wb))
+            return false;
+    }
+
+    for (; i < length; i++)
+    {
+        if (lowerByte(pa[i]) != lowerByte(pb[i]))
+            return false;
     }
 
     return true;
 }
 
+const HttpHeader * HttpHeaders::findHeader(HeaderId id) const
+{
+    uint16_t slot = slots[(size_t)id];
+
+    return slot == 0 ? nullptr : &_headers[slot - 1];
+}
+
+const HttpHeader * HttpHeaders::findHeader(std::string_view key) const
+{
+    HeaderId id = HttpHeader::lookupId(key);
+
+    if (id != HeaderId::Unknown)
+        return findHeader(id);
+
+    for (const auto &h : _headers)
+    {
+        if (h.id == HeaderId::Unknown && keyEquals(h.key, key))
+            return &h;
+    }
+
+    return nullptr;
+}
+
+void HttpHeaders::reindex()
+{
+    std::fill(std::begin(slots), std::end(slots), 0);
+
+    for (size_t i = _headers.size(); i-- > 0;)
+    {
+        if (_headers[i].id != HeaderId::Unknown)
+            slots[(size_t)_headers[i].id] = i + 1;
+    }
+}
+
+void HttpHeaders::append(HttpHeader && header)
+{
+    HeaderId id = header.id;
+
+    _headers.push_back(std::move(header));
+
+    if (id != HeaderId::Unknown && slots[(size_t)id] == 0)
+        slots[(size_t)id] = _headers.size();
+}
+
+void HttpHeaders::eraseDuplicates(size_t first)
+{
+    HeaderId id = _headers[first].id;
+    bool erased = false;
+
+    for (size_t i = first + 1; i < _headers.size();)
+    {
+        const HttpHeader &h = _headers[i];
+
+        if (h.id == id && (id != HeaderId::Unknown || keyEquals(h.key, _headers[first].key)))
+        {
+            _headers.erase(_headers.begin() + i);
+            erased = true;
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    if (erased)
+        reindex();
+}
+
+const HttpHeader & HttpHeaders::getHeader(std::string_view key) const
+{
+    const HttpHeader *h = findHeader(key);
+    if (h == nullptr)
+    {
+        return HttpHeaders::emptyHeader;
+    }
+    
+    return *h;
+
+}
+
+const HttpHeader & HttpHeaders::get(HeaderId id) const
+{
+    const HttpHeader *h = findHeader(id);
+    if (h == nullptr)
+    {
+        return HttpHeaders::emptyHeader;
+    }
+
+    return *h;
+}
+
+std::string_view HttpHeaders::getValueOrEmpty(std::string_view key) const
+{
+    const HttpHeader *h = findHeader(key);
+    if (h == nullptr) return {};
+
+    return h->getValue();
+}
+
+std::string_view HttpHeaders::getValueOrEmpty(HeaderId id) const
+{
+    const HttpHeader *h = findHeader(id);
+    if (h == nullptr) return {};
+
+    return h->getValue();
+}
+
+const HttpHeaders::HeaderList & HttpHeaders::getRawHeaders() const
+{
+    return _headers;
+}
+
+const bool HttpHeaders::headerExists(std::string_view key) const
+{
+    return findHeader(key) != nullptr;
+}
+
+const bool HttpHeaders::headerExists(HeaderId id) const
+{
+    return slots[(size_t)id] != 0;
+}
+
 
 void HttpHeaders::setHeader(const HttpHeader & header)
 {
-    _headers[header.key] = header;
+    setHeader(header.key, header.value);
 }
 
-void HttpHeaders::setHeader(const std::string & key, const std::string & value)
+void HttpHeaders::setHeader(std::string_view key, std::string_view value)
 {
-    std::string key_lower = key;
+    const HttpHeader *existing = findHeader(key);
 
-    for (auto &c : key_lower) c = std::tolower(c);
+    if (existing == nullptr)
+    {
+        append(HttpHeader(key, value, resource));
+        return;
+    }
+
+    size_t index = existing - _headers.data();
 
-    _headers[key_lower].key = key;
-    _headers[key_lower].value = value;
+    _headers[index].value.assign(value);
+
+    // Drop repeated headers, setHeader leaves a single one
+    eraseDuplicates(index);
 }
 
-void HttpHeaders::unsetHeader(const std::string & key)
+void HttpHeaders::setHeader(HeaderId id, std::string_view value)
 {
-    std::string key_lower = key;
+    uint16_t slot = slots[(size_t)id];
 
-    for (auto &c : key_lower) c = std::tolower(c);
+    if (slot == 0)
+    {
+        append(HttpHeader(id, value, resource));
+        return;
+    }
+
+    _headers[slot - 1].value.assign(value);
+    eraseDuplicates(slot - 1);
+}
 
-    auto h = _headers.find(key_lower);
+void HttpHeaders::addHeader(std::string_view key, std::string_view value)
+{
+    append(HttpHeader(key, value, resource));
+}
+
+void HttpHeaders::unsetHeader(std::string_view key)
+{
+    HeaderId id = HttpHeader::lookupId(key);
+
+    if (id != HeaderId::Unknown)
+    {
+        unsetHeader(id);
+        return;
+    }
+
+    for (auto it = _headers.begin(); it != _headers.end();)
+    {
+        if (it->id == HeaderId::Unknown && keyEquals(it->key, key))
+            it = _headers.erase(it);
+        else
+            ++it;
+    }
+
+    reindex();
+}
+
+void HttpHeaders::unsetHeader(HeaderId id)
+{
+    if (slots[(size_t)id] == 0)
+        return;
 
-    if (h != _headers.end())
+    for (auto it = _headers.begin(); it != _headers.end();)
     {
-        _headers.erase(h);
+        if (it->id == id)
+            it = _headers.erase(it);
+        else
+            ++it;
     }
 
+    reindex();
 }
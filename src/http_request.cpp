@@ -1,5 +1,12 @@
 #include "http_request.hpp"
 
+#include <algorithm>
+#include <cstring>
+
+HttpRequest::HttpRequest(std::pmr::memory_resource *resource)
+    : _headers{resource}, _body{resource}, parsed{resource}
+{ }
+
 const std::string & HttpRequest::ip() const
 {
     return _ip;
@@ -20,6 +27,174 @@ const std::string & HttpRequest::uri() const
     return _uri;
 }
 
+std::string_view HttpRequest::path() const
+{
+    std::string_view target = _uri;
+    return target.substr(0, target.find('?'));
+}
+
+std::string_view HttpRequest::queryString() const
+{
+    std::string_view target = _uri;
+    size_t offset = target.find('?');
+
+    if (offset == std::string_view::npos)
+        return {};
+
+    return target.substr(offset + 1);
+}
+
+static int hexValue(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+std::string_view HttpRequest::decode(std::string_view raw, bool plusIsSpace) const
+{
+    if (raw.find('%') == std::string_view::npos && (!plusIsSpace || raw.find('+') == std::string_view::npos))
+        return raw;
+
+    std::pmr::string &decoded = parsed.decoded.emplace_front();
+    decoded.reserve(raw.size());
+
+    for (size_t i = 0; i < raw.size(); i++)
+    {
+        char c = raw[i];
+
+        if (c == '+' && plusIsSpace)
+        {
+            c = ' ';
+        }
+        else if (c == '%' && i + 2 < raw.size() && hexValue(raw[i+1]) >= 0 && hexValue(raw[i+2]) >= 0)
+        {
+            c = (char)(hexValue(raw[i+1]) * 16 + hexValue(raw[i+2]));
+            i += 2;
+        }
+
+        // Invalid escapes are kept as they are
+        decoded.push_back(c);
+    }
+
+    return decoded;
+}
+
+/**
+ * @brief Remove spaces and tabs from both ends.
+ */
+static std::string_view trim(std::string_view s)
+{
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+    return s;
+}
+
+const HttpRequest::ParamList & HttpRequest::queryParams() const
+{
+    if (parsed.queryParsed)
+        return parsed.query;
+
+    parsed.queryParsed = true;
+
+    std::string_view rest = queryString();
+
+    while (!rest.empty())
+    {
+        size_t end = rest.find('&');
+        std::string_view param = rest.substr(0, end);
+        rest = end == std::string_view::npos ? std::string_view{} : rest.substr(end + 1);
+
+        if (param.empty())
+            continue;
+
+        size_t eq = param.find('=');
+        std::string_view key = param.substr(0, eq);
+        std::string_view value = eq == std::string_view::npos ? std::string_view{} : param.substr(eq + 1);
+
+        parsed.query.emplace_back(decode(key, true), decode(value, true));
+    }
+
+    return parsed.query;
+}
+
+std::string_view HttpRequest::query(std::string_view key) const
+{
+    for (const auto &param : queryParams())
+    {
+        if (param.first == key)
+            return param.second;
+    }
+
+    return {};
+}
+
+const HttpRequest::ParamList & HttpRequest::cookies() const
+{
+    if (parsed.cookiesParsed)
+        return parsed.cookies;
+
+    parsed.cookiesParsed = true;
+
+    // A client may split the cookies over multiple Cookie headers
+    _headers.forEachValue(HeaderId::Cookie, [this](std::string_view rest) {
+        while (!rest.empty())
+        {
+            size_t end = rest.find(';');
+            std::string_view pair = trim(rest.substr(0, end));
+            rest = end == std::string_view::npos ? std::string_view{} : rest.substr(end + 1);
+
+            size_t eq = pair.find('=');
+
+            if (eq == std::string_view::npos)
+                continue;
+
+            std::string_view value = trim(pair.substr(eq + 1));
+
+            if (value.size() >= 2 && value.front() == '"' && value.back() == '"')
+                value = value.substr(1, value.size() - 2);
+
+            parsed.cookies.emplace_back(trim(pair.substr(0, eq)), decode(value, false));
+        }
+    });
+
+    return parsed.cookies;
+}
+
+std::string_view HttpRequest::cookie(std::string_view key) const
+{
+    for (const auto &c : cookies())
+    {
+        if (c.first == key)
+            return c.second;
+    }
+
+    return {};
+}
+
+const HttpRequest::SegmentList & HttpRequest::pathSegments() const
+{
+    if (parsed.segmentsParsed)
+        return parsed.segments;
+
+    parsed.segmentsParsed = true;
+
+    std::string_view rest = path();
+
+    while (!rest.empty())
+    {
+        size_t end = rest.find('/');
+        std::string_view segment = rest.substr(0, end);
+        rest = end == std::string_view::npos ? std::string_view{} : rest.substr(end + 1);
+
+        if (!segment.empty())
+            parsed.segments.push_back(decode(segment, false));
+    }
+
+    return parsed.segments;
+}
+
 const std::string & HttpRequest::httpver() const
 {
     return _httpver;
@@ -33,4 +208,47 @@ const HttpHeaders & HttpRequest::headers() const
 const std::vector<std::string> & HttpRequest::regexMatches() const
 {
     return _regexMatches;
-}
\ No newline at end of file
+}
+
+HttpRequestBody & HttpRequest::body()
+{
+    return _body;
+}
+
+
+HttpRequestBody::HttpRequestBody(std::pmr::memory_resource *resource)
+    : buffered{resource}
+{ }
+
+void HttpRequestBody::init(int _sockfd, std::pmr::vector<uint8_t> &&_buffered, size_t contentLength)
+{
+    sockfd = _sockfd;
+    buffered = std::move(_buffered);
+    bufferedOffset = 0;
+
+    // A client may already have sent the next request behind the body, which is 
+    // not part of this body
+    if (buffered.size() > contentLength)
+        buffered.resize(contentLength);
+
+    remainingOnSocket = contentLength - buffered.size();
+}
+
+AsyncRead HttpRequestBody::read(uint8_t *buffer, size_t bufferLength)
+{
+    if (bufferedOffset < buffered.size())
+    {
+        size_t length = std::min(bufferLength, buffered.size() - bufferedOffset);
+        std::memcpy(buffer, buffered.data() + bufferedOffset, length);
+        bufferedOffset += length;
+
+        return AsyncRead(length);
+    }
+
+    return AsyncRead(sockfd, buffer, bufferLength, &remainingOnSocket);
+}
+
+size_t HttpRequestBody::remaining() const
+{
+    return (buffered.size() - bufferedOffset) + remainingOnSocket;
+}
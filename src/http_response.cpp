@@ -1,16 +1,19 @@
 #include "http_response.hpp"
+
+#include <utility>
+
 #include <unistd.h>
 #include <sys/socket.h>
 
 #include "http_err.hpp"
 
-HttpResponse::HttpResponse(int sockfd)
-    : sockfd{sockfd}
+HttpResponse::HttpResponse(int sockfd, std::pmr::memory_resource *resource)
+    : sockfd{sockfd}, headers{resource}
 {
     status = 200;
     statusPhrase = "OK";
     httpver = "HTTP/1.1";
-    headers.setHeader(HttpHeader::ContentType, "text/html; charset=utf-8");
+    headers.setHeader(HeaderId::ContentType, "text/html; charset=utf-8");
 }
 
 
@@ -30,6 +33,16 @@ HttpHeaders & HttpResponse::getHeadersWritable()
     return headers;
 }
 
+uint16_t HttpResponse::getStatus() const
+{
+    return status;
+}
+
+size_t HttpResponse::getBytesSent() const
+{
+    return bytesSent;
+}
+
 void HttpResponse::rawWriteAll(int sockfd, const uint8_t *data, size_t dataLength)
 {
     size_t bytes_written_total = 0;
@@ -37,7 +50,7 @@ void HttpResponse::rawWriteAll(int sockfd, const uint8_t *data, size_t dataLengt
 
     do
     {
-        bytes_written = write(sockfd, data + bytes_written_total, dataLength-bytes_written_total);
+        bytes_written = ::write(sockfd, data + bytes_written_total, dataLength-bytes_written_total);
 
         if (bytes_written < 0)
         {
@@ -45,20 +58,43 @@ void HttpResponse::rawWriteAll(int sockfd, const uint8_t *data, size_t dataLengt
         }
 
         bytes_written_total += bytes_written;
+        bytesSent += bytes_written;
     } while (bytes_written_total != dataLength);
+
+    if (capture) capture->append((const char*)data, dataLength);
 }
 
-void HttpResponse::sendHeader()
+std::pmr::string HttpResponse::buildHead() const
 {
-    std::string head = httpver + " " + std::to_string(status) + " " + statusPhrase + "\r\n";
+    std::pmr::string head(headers.getResource());
+    head.reserve(256);
+
+    head += httpver;
+    head += " ";
+    head += std::to_string(status);
+    head += " ";
+    head += statusPhrase;
+    head += "\r\n";
 
-    for (auto h : headers.getRawHeaders())
+    for (const auto &h : headers.getRawHeaders())
     {
-        head += h.first + ": " + h.second.getValue() + "\r\n";
+        head += h.getKey();
+        head += ": ";
+        head += h.getValue();
+        head += "\r\n";
     }
 
     head += "\r\n";
 
+    return head;
+}
+
+void HttpResponse::sendHeader()
+{
+    std::pmr::string head = buildHead();
+
+    headSent = true;
+
     rawWriteAll(sockfd, (uint8_t*)head.c_str(), head.size());
 }
 
@@ -78,14 +114,52 @@ void HttpResponse::sendBody(const uint8_t *bodyData, size_t bodyLength)
     rawWriteAll(sockfd, bodyData, bodyLength);
 }
 
+AsyncWrite HttpResponse::write(const uint8_t *data, size_t dataLength)
+{
+    std::pmr::string head(headers.getResource());
+
+    if (!headSent)
+    {
+        head = buildHead();
+        headSent = true;
+    }
+
+    return AsyncWrite(sockfd, std::move(head), data, dataLength, &bytesSent);
+}
+
+void HttpResponse::sendRaw(const uint8_t *data, size_t dataLength)
+{
+    headSent = true;
+
+    rawWriteAll(sockfd, data, dataLength);
+}
+
+std::string * HttpResponse::captureTo(std::string *buffer)
+{
+    return std::exchange(capture, buffer);
+}
+
 
 void HttpResponse::sendDefault404()
 {
     status = 404;
     statusPhrase = "Not found";
-    headers.setHeader(HttpHeader::ContentType, "text/html; charset=utf-8");
+    headers.setHeader(HeaderId::ContentType, "text/html; charset=utf-8");
 
     char body[] = "404 Not found";
 
-    sendAll((uint8_t*)body, sizeof(body));
-}
\ No newline at end of file
+    // Without the terminating null character
+    sendAll((uint8_t*)body, sizeof(body) - 1);
+}
+
+void HttpResponse::sendDefault503()
+{
+    status = 503;
+    statusPhrase = "Service Unavailable";
+    headers.setHeader(HeaderId::ContentType, "text/html; charset=utf-8");
+
+    char body[] = "503 Service Unavailable";
+
+    // Without the terminating null character
+    sendAll((uint8_t*)body, sizeof(body) - 1);
+}
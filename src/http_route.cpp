@@ -1,10 +1,25 @@
 #include "http_route.hpp"
 
+#include <stdexcept>
+
 HttpRoute::HttpRoute(const std::string &route, HttpHandlerFn handler, 
     HttpRoute::MatchType matchType)
-        : route{route}, route_matcher{"^" + route + "$"}, 
-            handler_fn {handler}, matchType{matchType}
-{ }
+        : route{route}, matchType{matchType}, handler_fn {handler}
+{
+    // Only regex routes use the matcher, so don't pay for compiling a regex 
+    // for routes that are compared as plain strings
+    if (matchType == HttpRoute::MatchType::Regex)
+    {
+        route_matcher = std::regex("^" + route + "$");
+    }
+}
+
+HttpRoute::HttpRoute(const std::string &route, HttpAsyncHandlerFn handler, 
+    HttpRoute::MatchType matchType)
+        : HttpRoute(route, HttpHandlerFn(), matchType)
+{
+    async_handler_fn = std::move(handler);
+}
 
 const std::string & HttpRoute::getRoute() const
 {
@@ -14,4 +29,24 @@ const std::string & HttpRoute::getRoute() const
 const HttpRoute::MatchType & HttpRoute::getMatchType() const
 {
     return matchType;
+}
+
+HttpRoute & HttpRoute::setExecutor(std::shared_ptr<HttpExecutor> _executor)
+{
+    executor = std::move(_executor);
+    return *this;
+}
+
+const std::shared_ptr<HttpExecutor> & HttpRoute::getExecutor() const
+{
+    return executor;
+}
+
+HttpRoute & HttpRoute::wrapHandler(const std::function<HttpHandlerFn (HttpHandlerFn handler)> &wrapper)
+{
+    if (async_handler_fn)
+        throw std::runtime_error("HttpRoute can't wrap a coroutine handler");
+
+    handler_fn = wrapper(std::move(handler_fn));
+    return *this;
 }
\ No newline at end of file
@@ -0,0 +1,39 @@
+#include "http_task.hpp"
+
+#include <iostream>
+
+#include "http_err.hpp"
+#include "http_route.hpp"
+
+void HttpTask::FinalAwaiter::await_suspend(Handle h) noexcept
+{
+    promise_type &promise = h.promise();
+
+    HttpRouteHandling handling = promise.handling;
+    std::exception_ptr exception = std::move(promise.exception);
+    Completion completion = std::move(promise.completion);
+
+    // Free the frame first, so the completion can start the next coroutine for 
+    // the connection without holding on to this frame
+    h.destroy();
+
+    if (exception)
+    {
+        try
+        {
+            std::rethrow_exception(exception);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << std::string(e.what()) + '\n';
+        }
+        catch (...)
+        {
+            std::cerr << "Unknown exception in coroutine handler\n";
+        }
+
+        return;
+    }
+
+    if (completion) completion(handling);
+}
@@ -4,6 +4,11 @@
 #include <sstream>
 #include <regex>
 #include <chrono>
+#include <charconv>
+#include <algorithm>
+#include <bit>
+#include <memory>
+#include <mutex>
 
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -13,10 +18,12 @@
 
 
 #include "threadpool.hpp"
+#include "cpu_topology.hpp"
+#include "io_loop.hpp"
 #include "httpd.hpp"
 
 
-bool parse_requestline_into(const std::string &head_text, HttpRequest &req)
+bool parse_requestline_into(std::string_view head_text, HttpRequest &req)
 {
     // Find the end of the request line
     auto offset_httpver_end = head_text.find("\r\n");
@@ -30,7 +37,7 @@ bool parse_requestline_into(const std::string &head_text, HttpRequest &req)
     if (offset_method_end == std::string::npos || offset_method_end > offset_httpver_end)
         return false;
 
-    std::string method = head_text.substr(0, offset_method_end);
+    auto method = head_text.substr(0, offset_method_end);
 
     // Find the space after the URI and before the HTTPVER
     auto offset_uri_end = head_text.find(" ", offset_method_end+1);
@@ -38,19 +45,19 @@ bool parse_requestline_into(const std::string &head_text, HttpRequest &req)
     if (offset_uri_end == std::string::npos || offset_uri_end > offset_httpver_end)
         return false;
 
-    std::string uri = head_text.substr(offset_method_end+1, offset_uri_end-offset_method_end -1);
+    auto uri = head_text.substr(offset_method_end+1, offset_uri_end-offset_method_end -1);
 
-    std::string httpver = head_text.substr(offset_uri_end+1, offset_httpver_end-offset_uri_end -1);
+    auto httpver = head_text.substr(offset_uri_end+1, offset_httpver_end-offset_uri_end -1);
 
-    req._method = method;
-    req._uri = uri;
-    req._httpver = httpver;
+    req._method.assign(method);
+    req._uri.assign(uri);
+    req._httpver.assign(httpver);
 
     return true;
 }
 
 
-bool parse_headers_into(const std::string &head_text, HttpRequest &req)
+bool parse_headers_into(std::string_view head_text, HttpRequest &req)
 {
     // The first call gets the end of the request line
     auto offset = head_text.find("\r\n");
@@ -76,7 +83,8 @@ bool parse_headers_into(const std::string &head_text, HttpRequest &req)
 
         auto header_val = head_text.substr(offset_colon+2, offset - offset_colon - 2);
 
-        req._headers.setHeader(header_key, header_val);
+        // Repeated headers (e.g. multiple Cookie lines) are all kept
+        req._headers.addHeader(header_key, header_val);
 
     }
 
@@ -85,21 +93,229 @@ bool parse_headers_into(const std::string &head_text, HttpRequest &req)
 }
 
 
+void HttpServer::logAccess(const HttpRequest &req, uint16_t status, size_t bytesSent,
+    std::chrono::steady_clock::time_point start)
+{
+    auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start
+    );
+
+    auto now = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    );
+
+    AccessLogRecord record;
+    record.timestampUs = (now - latency).count();
+    record.latencyUs = latency.count();
+    record.status = status;
+    record.port = req._port;
+    record.bytesSent = bytesSent;
+
+    AccessLogRecord::copyField(record.ip, req._ip);
+    AccessLogRecord::copyField(record.method, req._method.empty() ? "-" : req._method);
+    AccessLogRecord::copyField(record.uri, req._uri.empty() ? "-" : req._uri);
+
+    accessLog->log(record);
+}
+
+
+HttpServer::Connection::Connection(int sockfd)
+    : sockfd{sockfd}, arena{arenaBuffer, sizeof(arenaBuffer), std::pmr::new_delete_resource()}, 
+      req{&arena}, res{sockfd, &arena}, start{std::chrono::steady_clock::now()}
+{ }
+
+HttpServer::Connection::~Connection()
+{
+    close(sockfd);
+}
+
+
+/**
+ * @brief The maximum number of free connections kept per thread.
+ */
+static const size_t MAX_FREE_CONNECTIONS_PER_THREAD = 16;
+
+/**
+ * @brief The maximum number of free connections in the shared list of a node.
+ */
+static const size_t MAX_FREE_CONNECTIONS_SHARED = 256;
+
+/**
+ * @brief The number of shared lists. Nodes beyond it share a list.
+ */
+static const size_t CONNECTION_LIST_NODES = 16;
+
+/**
+ * @brief Stored in front of the connection memory. The memory is first touched by
+ * the thread that allocated it, so it stays on the NUMA node of that thread and 
+ * is only reused by threads of the same node.
+ */
+struct alignas(std::max_align_t) ConnectionBlockHeader
+{
+    unsigned int node;
+};
+
+/**
+ * @brief Free connection memory shared by the threads of one NUMA node. Threads 
+ * only lock it when their own free list is empty or full.
+ */
+struct SharedConnectionList
+{
+    std::mutex mtx;
+
+    /**
+     * @brief NOTE: The access is not synchronized by default and the mtx mutex must
+     * be used to access this variable.
+     */
+    std::vector<ConnectionBlockHeader*> blocks;
+
+    ~SharedConnectionList()
+    {
+        for (ConnectionBlockHeader *block : blocks) ::operator delete(block);
+    }
+};
+
+static SharedConnectionList sharedConnections[CONNECTION_LIST_NODES];
+
+/**
+ * @brief The free connection memory of the calling thread, all of one node. It is
+ * released to the heap when the thread exits.
+ */
+struct ConnectionFreeList
+{
+    ConnectionBlockHeader *blocks[MAX_FREE_CONNECTIONS_PER_THREAD];
+
+    size_t count = 0;
+
+    unsigned int node = 0;
+
+    ~ConnectionFreeList()
+    {
+        while (count > 0) ::operator delete(blocks[--count]);
+    }
+};
+
+static thread_local ConnectionFreeList connectionFreeList;
+
+/**
+ * @brief The NUMA node the calling thread runs on. Workers of the NumaNodes 
+ * placement are pinned to their node, so this is the node of their pool.
+ */
+static unsigned int currentConnectionNode()
+{
+    unsigned int cpu, node;
+
+    if (getcpu(&cpu, &node) != 0)
+        return 0;
+
+    return node % CONNECTION_LIST_NODES;
+}
+
+void * HttpServer::Connection::operator new(size_t size)
+{
+    unsigned int node = currentConnectionNode();
+
+    if (connectionFreeList.count > 0 && connectionFreeList.node == node)
+        return connectionFreeList.blocks[--connectionFreeList.count] + 1;
+
+    {
+        SharedConnectionList &shared = sharedConnections[node];
+        std::lock_guard<std::mutex> lock(shared.mtx);
+
+        if (!shared.blocks.empty())
+        {
+            ConnectionBlockHeader *block = shared.blocks.back();
+            shared.blocks.pop_back();
+            return block + 1;
+        }
+    }
+
+    ConnectionBlockHeader *block = static_cast<ConnectionBlockHeader*>(
+        ::operator new(sizeof(ConnectionBlockHeader) + size)
+    );
+    block->node = node;
+
+    return block + 1;
+}
+
+void HttpServer::Connection::operator delete(void *memory)
+{
+    ConnectionBlockHeader *block = static_cast<ConnectionBlockHeader*>(memory) - 1;
+
+    // Coroutine handlers often end on the IoLoop thread, which may run on another 
+    // node. The local list only keeps blocks of one node
+    if (connectionFreeList.count == 0)
+        connectionFreeList.node = block->node;
+
+    if (connectionFreeList.node == block->node && connectionFreeList.count < MAX_FREE_CONNECTIONS_PER_THREAD)
+    {
+        connectionFreeList.blocks[connectionFreeList.count++] = block;
+        return;
+    }
+
+    {
+        SharedConnectionList &shared = sharedConnections[block->node];
+        std::lock_guard<std::mutex> lock(shared.mtx);
+
+        if (shared.blocks.size() < MAX_FREE_CONNECTIONS_SHARED)
+        {
+            shared.blocks.push_back(block);
+            return;
+        }
+    }
+
+    ::operator delete(block);
+}
+
+
+void HttpServer::adaptReadBufferSize(size_t headSize)
+{
+    size_t current = readBufferSize.load(std::memory_order_relaxed);
+    size_t next = current;
+
+    if (headSize > current)
+    {
+        // Grow right away, so the next large head is read at once
+        next = std::min(std::bit_ceil(headSize), (size_t)MAX_READ_BUFFER_SIZE);
+    }
+    else if (headSize <= current / 2)
+    {
+        // Shrink slowly, a single small request shouldn't undo the growth
+        next = std::max(current - current / 16, (size_t)tcp_read_buffer_size);
+    }
+
+    // Concurrent updates may get lost, which only delays the adaption
+    if (next != current)
+        readBufferSize.store(next, std::memory_order_relaxed);
+}
+
+
 void HttpServer::handleConnection(int sockfd, const std::string &ip, uint16_t port)
 {
+    // The connection owns the socket from here on and closes it when the request 
+    // is finished, which may happen on an executor thread
+    auto conn = std::make_unique<Connection>(sockfd);
+
     // HttpRequest object will be filled with the parsed request parameters
-    HttpRequest req;
+    HttpRequest &req = conn->req;
     req._ip = ip;
     req._port = port;
 
+    // All buffers of the request are allocated from the arena of the connection
+    std::pmr::memory_resource *arena = &conn->arena;
+
     // Temporary read buffer that is used as an immediate target for receiving data
-    std::vector<uint8_t> buff(tcp_read_buffer_size);
+    // Its size adapts to the heads that clients recently sent
+    size_t read_size = readBufferSize.load(std::memory_order_relaxed);
+    std::pmr::vector<uint8_t> buff(read_size, arena);
 
     // Body buffer that will be filled with accidentally read body data
-    std::vector<uint8_t> body_buff;
+    std::pmr::vector<uint8_t> body_buff(arena);
 
     // String buffer that will be filled with the head data (request line + headers)
-    std::string head_str_buff;
+    // The arena never frees, so reserve once instead of growing step by step
+    std::pmr::string head_str_buff(arena);
+    head_str_buff.reserve(read_size);
 
     // Byte offset at which the head ends (the location of the head-end \r\n\r\n )
     // The body content begins at offset_head_end + 4
@@ -109,15 +325,34 @@ void HttpServer::handleConnection(int sockfd, const std::string &ip, uint16_t po
     ssize_t bytes_read;
 
     // Loop and read from socket while the head is not finished and there is still data available
-    while (offset_head_end == std::string::npos && (bytes_read = read(sockfd, buff.data(), tcp_read_buffer_size)) > 0)
+    while (offset_head_end == std::string::npos && (bytes_read = read(sockfd, buff.data(), buff.size())) > 0)
     {
+        // The head end may start up to 3 bytes before the new data
+        size_t search_from = head_str_buff.size() < 3 ? 0 : head_str_buff.size() - 3;
     
         // Append the newly read data to the head string buffer
         head_str_buff.append((char*)buff.data(), bytes_read);
 
         // Look for the head end. The loop will end if it is found
-        offset_head_end = head_str_buff.find("\r\n\r\n");
+        offset_head_end = head_str_buff.find("\r\n\r\n", search_from);
 
+        // The head didn't fit into one read. Read the rest of it in larger blocks
+        if (offset_head_end == std::string::npos && (size_t)bytes_read == buff.size() 
+            && buff.size() < MAX_READ_BUFFER_SIZE)
+        {
+            buff.resize(std::min(buff.size() * 2, (size_t)MAX_READ_BUFFER_SIZE));
+        }
+    }
+
+    if (offset_head_end != std::string::npos) adaptReadBufferSize(offset_head_end + 4);
+
+    // Insert potential body data into the body buffer. Body data might accidently be read 
+    // when the head-end (\r\n\r\n) is somewhere in the middle of the read buffer.
+    // This does not read the full body data, instead only data that was already read is 
+    // inserted
+    if (offset_head_end != std::string::npos && offset_head_end + 4 < head_str_buff.size())
+    {
+        body_buff.assign(head_str_buff.begin() + offset_head_end + 4, head_str_buff.end());
     }
 
     // Cut off the head-end, as well as body data that was possibly read
@@ -129,6 +364,7 @@ void HttpServer::handleConnection(int sockfd, const std::string &ip, uint16_t po
     {
         char resp[] = "HTTP/1.1 400 Bad Request\r\n\r\n";
         send(sockfd, resp, sizeof(resp), 0);
+        if (accessLog) logAccess(req, 400, sizeof(resp), conn->start);
         return;
     }
 
@@ -137,31 +373,58 @@ void HttpServer::handleConnection(int sockfd, const std::string &ip, uint16_t po
     {
         char resp[] = "HTTP/1.1 400 Bad Request\r\n\r\n";
         send(sockfd, resp, sizeof(resp), 0);
+        if (accessLog) logAccess(req, 400, sizeof(resp), conn->start);
         return;
     }
 
 
-    // Insert potential body data into the body buffer. Body data might accidently be read 
-    // when the head-end (\r\n\r\n) is somewhere in the middle of the read buffer.
-    // This does not read the full body data, instead only data that was already read is 
-    // inserted
-    if (offset_head_end < head_str_buff.size()-1)
+    // The rest of the body is read by coroutine handlers through req.body()
+    size_t content_length = 0;
+
+    // An invalid Content-Length is treated like a missing one
+    std::string_view content_length_str = req._headers.getValueOrEmpty(HeaderId::ContentLength);
+    if (std::from_chars(content_length_str.data(), content_length_str.data() + content_length_str.size(), 
+            content_length).ec != std::errc())
     {
-        body_buff.insert(body_buff.end(), buff.begin() + offset_head_end + 4, buff.begin() + bytes_read);
+        content_length = 0;
+    }
+
+    req._body.init(sockfd, std::move(body_buff), content_length);
+
+    // Run the before hooks of the middlewares. Any hook can end the request 
+    // before it reaches the routes
+    for (const auto &hook : beforeHooks)
+    {
+        if (hook(req, conn->res) == HttpRouteHandling::End)
+        {
+            finishConnection(*conn, true);
+            return;
+        }
     }
-    
-    
-    // Prepare HttpResponse 
-    HttpResponse res(sockfd);
+
+    routeConnection(std::move(conn), 0, nullptr);
+}
+
+
+void HttpServer::routeConnection(std::unique_ptr<Connection> conn, size_t firstRoute, HttpExecutor *current)
+{
+    HttpRequest &req = conn->req;
+    HttpResponse &res = conn->res;
+
+    // Routes are matched against the path, without the query string
+    std::string_view path = req.path();
 
     // Try to match routes available for the server using the dedicated matching type 
     // for each available route.
-    bool finalHandled = false;
-    for (const auto &route : routes)
+    for (size_t i = firstRoute; i < routes.size(); i++)
     {
+        const auto &route = routes[i];
+
         bool match_found = false;
 
-        std::smatch matches;
+        size_t previous_matches = req._regexMatches.size();
+
+        std::cmatch matches;
 
         switch (route.matchType)
         {
@@ -170,11 +433,11 @@ void HttpServer::handleConnection(int sockfd, const std::string &ip, uint16_t po
         break;
         
         case HttpRoute::MatchType::Regex:
-            if (std::regex_search(req._uri, matches, route.route_matcher))
+            if (std::regex_search(path.data(), path.data() + path.size(), matches, route.route_matcher))
             {
-                for (auto m : matches)
+                for (const auto &m : matches)
                 {
-                    req._regexMatches.push_back(m);
+                    req._regexMatches.push_back(m.str());
                 }
 
                 match_found = true;
@@ -182,37 +445,167 @@ void HttpServer::handleConnection(int sockfd, const std::string &ip, uint16_t po
         break;
 
         case HttpRoute::MatchType::Literal:
-            if (route.route == req._uri)
+            if (route.route == path)
             {
                 match_found = true;
             }
         break;
 
         case HttpRoute::MatchType::StartsWith:
-            if (req._uri.compare(0, route.route.size(), route.route) == 0)
+            if (path.substr(0, route.route.size()) == route.route)
             {
                 match_found = true;
             }
         break;
         }
 
-        if (match_found) 
+        if (!match_found) continue;
+
+        HttpExecutor *executor = route.executor.get();
+
+        if (executor && executor != current)
         {
-            auto routeType = route.handler_fn(req, res);
-            if (routeType == HttpRouteHandling::End)
+            // Hand the connection over to the executor of the route, which calls the 
+            // handler and continues with the remaining routes. The task keeps the 
+            // connection even if it is rejected, so answer through a raw pointer
+            Connection *handedOver = conn.get();
+
+            // The executor matches the route again, which must not add the 
+            // matches a second time
+            req._regexMatches.resize(previous_matches);
+
+            Threadpool::Task task([this, conn = std::move(conn), i, executor]() mutable {
+                resumeRouting(std::move(conn), i, executor);
+            });
+
+            if (!executor->trySubmit(std::move(task)))
             {
-                finalHandled = true;
-                break;
+                // The executor is overloaded. Reject the request instead of blocking 
+                // the server worker
+                handedOver->res.sendDefault503();
+                finishConnection(*handedOver, true);
             }
+
+            return;
+        }
+
+        if (route.async_handler_fn)
+        {
+            // The coroutine takes over the connection. The routing continues when 
+            // it has finished, either right away or on the IoLoop thread
+            HttpTask task = route.async_handler_fn(req, res);
+
+            task.start([this, conn = std::move(conn), i, current](HttpRouteHandling handling) mutable {
+                continueAfterTask(std::move(conn), i, current, handling);
+            });
+
+            return;
+        }
+
+        if (route.handler_fn(req, res) == HttpRouteHandling::End)
+        {
+            finishConnection(*conn, true);
+            return;
         }
+    }
+
+    finishConnection(*conn, false);
+}
+
+
+void HttpServer::resumeRouting(std::unique_ptr<Connection> conn, size_t firstRoute, HttpExecutor *current)
+{
+    try
+    {
+        routeConnection(std::move(conn), firstRoute, current);
+    }
+    catch (const HttpException& e)
+    {
+        std::cerr << std::string(e.what()) + '\n';
+    }
+}
+
+
+/**
+ * @brief The thread that hands tasks to full pools with the blocking calls, so 
+ * the IoLoop thread never waits for a pool. The pool is never destroyed, since 
+ * coroutines may still finish while static objects are destroyed at exit.
+ */
+static Threadpool & handoffPool()
+{
+    static Threadpool *pool = new Threadpool(1);
+    return *pool;
+}
 
+void HttpServer::continueAfterTask(std::unique_ptr<Connection> conn, size_t route, HttpExecutor *current, 
+    HttpRouteHandling handling)
+{
+    if (handling == HttpRouteHandling::End)
+    {
+        finishConnection(*conn, true);
+        return;
+    }
+
+    // This is called from the final suspension of the coroutine, where exceptions
+    // must not escape
+    if (!IoLoop::getDefault().isLoopThread())
+    {
+        resumeRouting(std::move(conn), route + 1, current);
+        return;
     }
 
+    // The remaining routes may block, which must not happen on the IoLoop thread. 
+    // Hand them back to the threads the coroutine was started on
+    Threadpool::Task task([this, conn = std::move(conn), route, current]() mutable {
+        resumeRouting(std::move(conn), route + 1, current);
+    });
+
+    bool queued = current 
+        ? current->trySubmit(std::move(task)) 
+        : workerPool && workerPool->tryAddTask(std::move(task));
 
+    if (queued) return;
+
+    // The coroutine may already have written a part of the response, so the 
+    // request can't be rejected anymore. Wait for space on the handoff thread. 
+    // The task doesn't fit into another task, this is the rare overload case
+    handoffPool().addTask([this, current, pending = std::make_unique<Threadpool::Task>(std::move(task))]() mutable {
+        try
+        {
+            if (current)
+                current->submit(std::move(*pending));
+            else
+                workerPool->addTask(std::move(*pending));
+        }
+        catch (const std::runtime_error& e)
+        {
+            // The pool was shut down, the connection is dropped
+            std::cerr << e.what() + std::string("\n");
+        }
+    });
+}
+
+
+void HttpServer::finishConnection(Connection &conn, bool finalHandled)
+{
     // If none of the routes match, use the default handler. This will cause a 
     // 404 Not found status code by default
-    if (!finalHandled) defaultHandler(req, res);
+    if (!finalHandled) defaultHandler(conn.req, conn.res);
 
+    // Run the after hooks of the middlewares, now that the response is complete
+    if (!afterHooks.empty())
+    {
+        auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - conn.start
+        );
+
+        for (const auto &hook : afterHooks)
+        {
+            hook(conn.req, conn.res, latency);
+        }
+    }
+
+    if (accessLog) logAccess(conn.req, conn.res.status, conn.res.bytesSent, conn.start);
 }
 
 
@@ -223,6 +616,39 @@ HttpRouteHandling HttpServer::defaultHandlerFunction(const HttpRequest &req, Htt
 }
 
 
+void HttpServer::addMiddleware(HttpMiddleware middleware)
+{
+    if (middleware.before) beforeHooks.push_back(std::move(middleware.before));
+    if (middleware.after) afterHooks.push_back(std::move(middleware.after));
+}
+
+void HttpServer::setDefaultHandler(const HttpHandlerFn &handler)
+{
+    defaultHandler = handler;
+}
+
+void HttpServer::setScheduling(Threadpool::Scheduling _scheduling)
+{
+    scheduling = _scheduling;
+}
+
+void HttpServer::setWorkerPlacement(WorkerPlacement placement)
+{
+    workerPlacement = placement;
+}
+
+void HttpServer::setElasticWorkers(const Threadpool::ElasticLimits &limits)
+{
+    elasticWorkers = true;
+    elasticLimits = limits;
+}
+
+void HttpServer::setAccessLog(std::shared_ptr<AccessLog> log)
+{
+    accessLog = log;
+}
+
+
 HttpServer::HttpServer(uint16_t port, std::string ip)
     : port{port}, ip{ip}
 {
@@ -234,6 +660,62 @@ HttpServer::HttpServer(uint16_t port, std::string ip)
 }
 
 
+void HttpServer::createThreadpools(std::vector<std::unique_ptr<Threadpool>> &pools, std::vector<int> &poolOfCpu)
+{
+    createThreadpoolsPlaced(pools, poolOfCpu);
+
+    if (elasticWorkers)
+    {
+        for (auto &pool : pools)
+        {
+            pool->enableElasticSizing(elasticLimits);
+        }
+    }
+}
+
+void HttpServer::createThreadpoolsPlaced(std::vector<std::unique_ptr<Threadpool>> &pools, std::vector<int> &poolOfCpu)
+{
+    if (workerPlacement == WorkerPlacement::Unpinned)
+    {
+        pools.push_back(std::make_unique<Threadpool>(numberOfThreads, queuedConnections, scheduling));
+        return;
+    }
+
+    CpuTopology topology = CpuTopology::discover();
+
+    if (workerPlacement == WorkerPlacement::PhysicalCores || topology.getNodes().size() < 2)
+    {
+        std::vector<int> cores = topology.getPhysicalCores();
+
+        pools.push_back(std::make_unique<Threadpool>(numberOfThreads, queuedConnections, scheduling));
+        pools.back()->pinWorkers(cores, true);
+        return;
+    }
+
+    // One pool per NUMA node. The configured number of threads is split between 
+    // the nodes
+    const auto &nodes = topology.getNodes();
+
+    for (int node : nodes)
+    {
+        int workers = numberOfThreads == Threadpool::AUTO_NO_WORKERS
+            ? topology.getPhysicalCores(node).size()
+            : std::max<int>(1, numberOfThreads / nodes.size());
+
+        if (workers < 1) workers = 1;
+
+        pools.push_back(std::make_unique<Threadpool>(workers, queuedConnections, scheduling));
+        pools.back()->pinWorkers(topology.getCpusOfNode(node), false);
+
+        for (int cpu : topology.getCpusOfNode(node))
+        {
+            if (cpu >= (int)poolOfCpu.size()) poolOfCpu.resize(cpu + 1, 0);
+            poolOfCpu[cpu] = pools.size() - 1;
+        }
+    }
+}
+
+
 void HttpServer::serveForever()
 {
     // The number of connections that the server can keep on wait (not yet accepted) before
@@ -273,8 +755,13 @@ void HttpServer::serveForever()
         // Listen to new connections
         listen(sockfd_listen, waiting_connections);
 
-        // Create and run the threadpool
-        Threadpool tp(numberOfThreads, queuedConnections);
+        // Create and run the threadpools
+        std::vector<std::unique_ptr<Threadpool>> pools;
+        std::vector<int> poolOfCpu;
+        createThreadpools(pools, poolOfCpu);
+        workerPool = pools[0].get();
+
+        readBufferSize.store(tcp_read_buffer_size);
 
         // Accept-Handle-Repeat loop
         // This loops forever and handles new requests
@@ -301,7 +788,23 @@ void HttpServer::serveForever()
             // Pass the tcp connection socket to the http handling function
             // handleConnection(remote_sockfd);
 
-            tp.addTask([this, remote_sockfd, remote_saddr]() {
+            // With one pool per NUMA node, hand the connection to the pool of the 
+            // node that received it
+            Threadpool *tp = pools[0].get();
+
+            if (pools.size() > 1)
+            {
+                int cpu = -1;
+                socklen_t cpu_len = sizeof(cpu);
+
+                if (getsockopt(remote_sockfd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &cpu_len) == 0 
+                    && cpu >= 0 && cpu < (int)poolOfCpu.size())
+                {
+                    tp = pools[poolOfCpu[cpu]].get();
+                }
+            }
+
+            tp->addTask([this, remote_sockfd, remote_saddr]() {
                 try
                 {
                     // inet_ntoa returns the string in a statically allocated buffer
@@ -310,14 +813,13 @@ void HttpServer::serveForever()
 
                     uint16_t remote_port = ntohs(remote_saddr.sin_port);
 
+                    // Closes the socket once the request is finished
                     handleConnection(remote_sockfd, remote_ip, remote_port);
-                    close(remote_sockfd);
                 
                 }
                 catch (const HttpException& e)
                 {
-                    close(remote_sockfd);
-                    std::cerr << e.what() + '\n';
+                    std::cerr << std::string(e.what()) + '\n';
                 }
             });
 
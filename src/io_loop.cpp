@@ -0,0 +1,164 @@
+#include "io_loop.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+/**
+ * @brief The maximum number of events handled per epoll_wait call.
+ */
+static const int IO_LOOP_MAX_EVENTS = 64;
+
+IoLoop::IoLoop()
+{
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0)
+    {
+        throw std::runtime_error("IoLoop failed to create the epoll instance");
+    }
+
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeFd < 0)
+    {
+        close(epollFd);
+        throw std::runtime_error("IoLoop failed to create the wakeup eventfd");
+    }
+
+    // The wakeup fd is registered without a waiter and stays registered
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.ptr = nullptr;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+
+    loopThread = std::thread(&IoLoop::run, this);
+}
+
+IoLoop::~IoLoop()
+{
+    stopped.store(true);
+    wakeUp();
+
+    if (loopThread.joinable())
+        loopThread.join();
+
+    close(wakeFd);
+    close(epollFd);
+}
+
+IoLoop & IoLoop::getDefault()
+{
+    static IoLoop loop;
+    return loop;
+}
+
+void IoLoop::wakeUp()
+{
+    uint64_t one = 1;
+    // Can only fail if the counter is about to overflow, in which case the loop 
+    // is woken up anyway
+    (void)!write(wakeFd, &one, sizeof(one));
+}
+
+void IoLoop::waitFd(int fd, uint32_t events, IoWaiter *waiter)
+{
+    epoll_event ev = {};
+    ev.events = events | EPOLLONESHOT;
+    ev.data.ptr = waiter;
+
+    // The fd stays registered after a oneshot event fired, so later waits only 
+    // re-arm it. Closing the fd removes it from the epoll instance
+    if (epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev) != 0)
+    {
+        if (errno != ENOENT || epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) != 0)
+        {
+            throw std::runtime_error("IoLoop failed to register the file descriptor");
+        }
+    }
+}
+
+void IoLoop::waitUntil(std::chrono::steady_clock::time_point deadline, IoWaiter *waiter)
+{
+    bool earliest;
+
+    {
+        std::lock_guard<std::mutex> lock(mtxTimers);
+
+        timers.push_back(Timer{deadline, waiter});
+        std::push_heap(timers.begin(), timers.end(), std::greater<Timer>());
+
+        earliest = timers.front().waiter == waiter;
+    }
+
+    // The loop thread only has to recalculate its timeout if the new timer 
+    // expires first
+    if (earliest && !isLoopThread())
+        wakeUp();
+}
+
+bool IoLoop::isLoopThread() const
+{
+    return std::this_thread::get_id() == loopThread.get_id();
+}
+
+int IoLoop::runExpiredTimers()
+{
+    while (true)
+    {
+        IoWaiter *waiter;
+
+        {
+            std::lock_guard<std::mutex> lock(mtxTimers);
+
+            if (timers.empty())
+                return -1;
+
+            auto now = std::chrono::steady_clock::now();
+            auto deadline = timers.front().deadline;
+
+            if (deadline > now)
+            {
+                // Round up, so the loop doesn't wake up just before the deadline
+                auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - now);
+                return (int)std::min<int64_t>(remaining.count(), 1000 * 60);
+            }
+
+            std::pop_heap(timers.begin(), timers.end(), std::greater<Timer>());
+            waiter = timers.back().waiter;
+            timers.pop_back();
+        }
+
+        // The waiter may add new timers, so it is called without the lock
+        waiter->onReady();
+    }
+}
+
+void IoLoop::run()
+{
+    epoll_event events[IO_LOOP_MAX_EVENTS];
+
+    while (!stopped.load())
+    {
+        int timeout = runExpiredTimers();
+
+        int n = epoll_wait(epollFd, events, IO_LOOP_MAX_EVENTS, timeout);
+
+        for (int i = 0; i < n; i++)
+        {
+            IoWaiter *waiter = static_cast<IoWaiter*>(events[i].data.ptr);
+
+            if (!waiter)
+            {
+                uint64_t count;
+                (void)!read(wakeFd, &count, sizeof(count));
+                continue;
+            }
+
+            waiter->onReady();
+        }
+    }
+}
@@ -0,0 +1,93 @@
+#include "mapped_file.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::shared_ptr<const MappedFile> MappedFile::open(const std::string &path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0)
+        return nullptr;
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        close(fd);
+        return nullptr;
+    }
+
+    auto file = fromDescriptor(fd, st);
+
+    // The mapping stays valid after closing the descriptor
+    close(fd);
+
+    return file;
+}
+
+std::shared_ptr<const MappedFile> MappedFile::fromDescriptor(int fd, const struct stat &st)
+{
+    std::shared_ptr<MappedFile> file(new MappedFile());
+
+    // The own descriptor refers to the mapped inode, even if the path is replaced
+    file->fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    file->st = st;
+
+    if (file->fd < 0)
+        return nullptr;
+
+    size_t size = st.st_size;
+
+    // Empty files can't be mapped, they are served without a mapping
+    if (size == 0)
+        return file;
+
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (mapping == MAP_FAILED)
+        return nullptr;
+
+    file->mapping = static_cast<uint8_t*>(mapping);
+    file->length = size;
+
+    // Start reading the file in the background, so the first response doesn't 
+    // wait for page faults one page at a time
+    madvise(mapping, size, MADV_WILLNEED);
+
+#ifdef MADV_HUGEPAGE
+    if (size >= HUGEPAGE_THRESHOLD)
+        madvise(mapping, size, MADV_HUGEPAGE);
+#endif
+
+    return file;
+}
+
+MappedFile::~MappedFile()
+{
+    if (mapping) munmap(mapping, length);
+    if (fd >= 0) close(fd);
+}
+
+const uint8_t * MappedFile::data() const
+{
+    return mapping;
+}
+
+size_t MappedFile::size() const
+{
+    return length;
+}
+
+bool MappedFile::isUnchanged() const
+{
+    struct stat current;
+
+    if (fstat(fd, &current) != 0)
+        return false;
+
+    return current.st_size == st.st_size && current.st_mtim.tv_sec == st.st_mtim.tv_sec 
+        && current.st_mtim.tv_nsec == st.st_mtim.tv_nsec;
+}
@@ -0,0 +1,83 @@
+#include "mime_types.hpp"
+
+#include <cstddef>
+
+struct MimeType
+{
+    std::string_view extension;
+    std::string_view type;
+};
+
+/**
+ * @brief The known extensions, in lower case.
+ */
+static constexpr MimeType mimeTypes[] = {
+    {"html", "text/html; charset=utf-8"},
+    {"htm", "text/html; charset=utf-8"},
+    {"css", "text/css; charset=utf-8"},
+    {"js", "text/javascript; charset=utf-8"},
+    {"mjs", "text/javascript; charset=utf-8"},
+    {"json", "application/json"},
+    {"map", "application/json"},
+    {"txt", "text/plain; charset=utf-8"},
+    {"csv", "text/csv; charset=utf-8"},
+    {"md", "text/markdown; charset=utf-8"},
+    {"xml", "application/xml"},
+    {"svg", "image/svg+xml"},
+    {"png", "image/png"},
+    {"jpg", "image/jpeg"},
+    {"jpeg", "image/jpeg"},
+    {"gif", "image/gif"},
+    {"webp", "image/webp"},
+    {"avif", "image/avif"},
+    {"ico", "image/x-icon"},
+    {"woff", "font/woff"},
+    {"woff2", "font/woff2"},
+    {"ttf", "font/ttf"},
+    {"otf", "font/otf"},
+    {"wasm", "application/wasm"},
+    {"pdf", "application/pdf"},
+    {"zip", "application/zip"},
+    {"gz", "application/gzip"},
+    {"mp4", "video/mp4"},
+    {"webm", "video/webm"},
+    {"mp3", "audio/mpeg"},
+    {"ogg", "audio/ogg"},
+    {"wav", "audio/wav"},
+};
+
+static bool extensionEquals(std::string_view extension, std::string_view lowerCase)
+{
+    if (extension.size() != lowerCase.size())
+        return false;
+
+    for (size_t i = 0; i < extension.size(); i++)
+    {
+        char c = extension[i];
+        if (c >= 'A' && c <= 'Z') c |= 0x20;
+
+        if (c != lowerCase[i])
+            return false;
+    }
+
+    return true;
+}
+
+std::string_view mimeTypeForPath(std::string_view path)
+{
+    size_t dot = path.rfind('.');
+    size_t slash = path.rfind('/');
+
+    if (dot == std::string_view::npos || (slash != std::string_view::npos && dot < slash))
+        return "application/octet-stream";
+
+    std::string_view extension = path.substr(dot + 1);
+
+    for (const auto &mime : mimeTypes)
+    {
+        if (extensionEquals(extension, mime.extension))
+            return mime.type;
+    }
+
+    return "application/octet-stream";
+}
@@ -0,0 +1,211 @@
+#include "open_file_cache.hpp"
+
+#include <algorithm>
+#include <functional>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "file_cache.hpp"
+
+OpenFile::OpenFile(int fd, const struct stat &st)
+    : fd{fd}, st(st), tag{CachedFile::makeETag(st)}
+{ }
+
+OpenFile::~OpenFile()
+{
+    close(fd);
+}
+
+int OpenFile::descriptor() const
+{
+    return fd;
+}
+
+size_t OpenFile::size() const
+{
+    return st.st_size;
+}
+
+const struct timespec & OpenFile::modified() const
+{
+    return st.st_mtim;
+}
+
+const std::string & OpenFile::etag() const
+{
+    return tag;
+}
+
+bool OpenFile::isSameFile(const struct stat &current) const
+{
+    return current.st_dev == st.st_dev && current.st_ino == st.st_ino && current.st_size == st.st_size
+        && current.st_mtim.tv_sec == st.st_mtim.tv_sec && current.st_mtim.tv_nsec == st.st_mtim.tv_nsec;
+}
+
+
+/**
+ * @brief Open the path if it is a regular file.
+ *
+ * @return The file or nullptr if the path is not a readable regular file.
+ */
+static std::shared_ptr<const OpenFile> openRegularFile(const std::string &path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0)
+        return nullptr;
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        close(fd);
+        return nullptr;
+    }
+
+    // Files are read front to back, so the kernel may read ahead more aggressively
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    return std::make_shared<const OpenFile>(fd, st);
+}
+
+OpenFileCache::OpenFileCache(size_t maxEntries, Clock::duration ttl)
+    : shardCapacity{std::max<size_t>(maxEntries / NUMBER_OF_SHARDS, 1)}, ttl{ttl}
+{ }
+
+OpenFileCache & OpenFileCache::getDefault()
+{
+    static OpenFileCache cache;
+    return cache;
+}
+
+OpenFileCache::Shard & OpenFileCache::shardOf(std::string_view path)
+{
+    return shards[std::hash<std::string_view>{}(path) % NUMBER_OF_SHARDS];
+}
+
+std::shared_ptr<const OpenFile> OpenFileCache::open(const std::string &path)
+{
+    Shard &shard = shardOf(path);
+
+    Clock::time_point now = Clock::now();
+
+    std::shared_ptr<const OpenFile> cached;
+    bool found = false;
+
+    {
+        std::lock_guard<std::mutex> lock(shard.mtx);
+
+        auto it = shard.index.find(path);
+
+        if (it != shard.index.end())
+        {
+            Entry &entry = *it->second;
+
+            // Move the entry to the front, the node and its key stay valid
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+
+            if (now < entry.expires)
+                return entry.file;
+
+            cached = entry.file;
+            found = true;
+        }
+    }
+
+    // The filesystem is only checked without the lock
+    if (found && cached)
+    {
+        struct stat st;
+
+        if (stat(path.c_str(), &st) == 0 && cached->isSameFile(st))
+        {
+            put(path, cached, now);
+            return cached;
+        }
+    }
+
+    std::shared_ptr<const OpenFile> file = openRegularFile(path);
+
+    put(path, file, now);
+
+    return file;
+}
+
+void OpenFileCache::put(const std::string &path, std::shared_ptr<const OpenFile> file, Clock::time_point now)
+{
+    Shard &shard = shardOf(path);
+
+    // The replaced and evicted files are closed after the lock
+    std::shared_ptr<const OpenFile> replaced;
+    LruList evicted;
+
+    std::lock_guard<std::mutex> lock(shard.mtx);
+
+    auto it = shard.index.find(path);
+
+    if (it != shard.index.end())
+    {
+        replaced = std::move(it->second->file);
+        it->second->file = std::move(file);
+        it->second->expires = now + ttl;
+        return;
+    }
+
+    while (!shard.lru.empty() && shard.lru.size() >= shardCapacity)
+    {
+        auto last = std::prev(shard.lru.end());
+
+        shard.index.erase(last->path);
+        evicted.splice(evicted.end(), shard.lru, last);
+    }
+
+    shard.lru.emplace_front(Entry{path, std::move(file), now + ttl});
+    shard.index.emplace(shard.lru.front().path, shard.lru.begin());
+}
+
+void OpenFileCache::erase(std::string_view path)
+{
+    Shard &shard = shardOf(path);
+
+    LruList released;
+
+    std::lock_guard<std::mutex> lock(shard.mtx);
+
+    auto it = shard.index.find(path);
+
+    if (it != shard.index.end())
+    {
+        LruList::iterator entry = it->second;
+
+        shard.index.erase(it);
+        released.splice(released.end(), shard.lru, entry);
+    }
+}
+
+void OpenFileCache::clear()
+{
+    for (auto &shard : shards)
+    {
+        LruList released;
+
+        std::lock_guard<std::mutex> lock(shard.mtx);
+
+        released.swap(shard.lru);
+        shard.index.clear();
+    }
+}
+
+size_t OpenFileCache::getEntryCount()
+{
+    size_t count = 0;
+
+    for (auto &shard : shards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        count += shard.lru.size();
+    }
+
+    return count;
+}
@@ -0,0 +1,576 @@
+#include "response_cache.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <condition_variable>
+#include <functional>
+
+#include <strings.h>
+
+CachedResponse::CachedResponse(std::string &&bytes, uint16_t status, Clock::time_point freshUntil,
+    Clock::time_point staleUntil)
+        : bytes{std::move(bytes)}, status{status}, freshUntil{freshUntil}, staleUntil{staleUntil}
+{ }
+
+const std::string & CachedResponse::data() const
+{
+    return bytes;
+}
+
+uint16_t CachedResponse::getStatus() const
+{
+    return status;
+}
+
+bool CachedResponse::isFresh(Clock::time_point now) const
+{
+    return now < freshUntil;
+}
+
+bool CachedResponse::isUsableStale(Clock::time_point now) const
+{
+    return now < staleUntil;
+}
+
+bool CachedResponse::beginRevalidate() const
+{
+    return !revalidating.exchange(true, std::memory_order_acq_rel);
+}
+
+void CachedResponse::endRevalidate() const
+{
+    revalidating.store(false, std::memory_order_release);
+}
+
+
+ResponseCache::ResponseCache(size_t capacityBytes, size_t maxResponseSize)
+    : shardCapacity{capacityBytes / NUMBER_OF_SHARDS}, maxResponseSize{maxResponseSize}
+{ }
+
+ResponseCache::Shard & ResponseCache::shardOf(std::string_view key)
+{
+    return shards[std::hash<std::string_view>{}(key) % NUMBER_OF_SHARDS];
+}
+
+size_t ResponseCache::entrySize(const LruList::value_type &entry)
+{
+    return entry.first.size() + entry.second->data().size();
+}
+
+std::shared_ptr<const CachedResponse> ResponseCache::get(std::string_view key, CachedResponse::Clock::time_point now)
+{
+    Shard &shard = shardOf(key);
+
+    std::shared_ptr<const CachedResponse> released;
+
+    std::lock_guard<std::mutex> lock(shard.mtx);
+
+    auto it = shard.index.find(key);
+
+    if (it == shard.index.end())
+        return nullptr;
+
+    LruList::iterator entry = it->second;
+
+    if (!entry->second->isUsableStale(now))
+    {
+        released = entry->second;
+        shard.bytes -= entrySize(*entry);
+        shard.index.erase(it);
+        shard.lru.erase(entry);
+        return nullptr;
+    }
+
+    // Move the entry to the front, the node and its key stay valid
+    shard.lru.splice(shard.lru.begin(), shard.lru, entry);
+
+    return entry->second;
+}
+
+bool ResponseCache::put(std::string_view key, std::shared_ptr<const CachedResponse> response)
+{
+    size_t size = key.size() + response->data().size();
+
+    if (response->data().size() > maxResponseSize || size > shardCapacity)
+        return false;
+
+    Shard &shard = shardOf(key);
+
+    // The evicted responses are released after the lock
+    LruList evicted;
+
+    {
+        std::lock_guard<std::mutex> lock(shard.mtx);
+
+        auto it = shard.index.find(key);
+
+        if (it != shard.index.end())
+        {
+            shard.bytes -= entrySize(*it->second);
+            LruList::iterator entry = it->second;
+            shard.index.erase(it);
+            evicted.splice(evicted.end(), shard.lru, entry);
+        }
+
+        while (!shard.lru.empty() && shard.bytes + size > shardCapacity)
+        {
+            auto last = std::prev(shard.lru.end());
+
+            shard.bytes -= entrySize(*last);
+            shard.index.erase(last->first);
+            evicted.splice(evicted.end(), shard.lru, last);
+        }
+
+        shard.lru.emplace_front(std::string(key), std::move(response));
+        shard.index.emplace(shard.lru.front().first, shard.lru.begin());
+        shard.bytes += size;
+    }
+
+    return true;
+}
+
+void ResponseCache::clear()
+{
+    for (auto &shard : shards)
+    {
+        LruList released;
+
+        std::lock_guard<std::mutex> lock(shard.mtx);
+
+        released.swap(shard.lru);
+        shard.index.clear();
+        shard.bytes = 0;
+    }
+}
+
+size_t ResponseCache::getCachedBytes()
+{
+    size_t bytes = 0;
+
+    for (auto &shard : shards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        bytes += shard.bytes;
+    }
+
+    return bytes;
+}
+
+
+/**
+ * @brief How long a response may be replayed.
+ */
+struct Freshness
+{
+    bool storable = true;
+
+    std::chrono::milliseconds ttl;
+
+    std::chrono::milliseconds staleWhileRevalidate;
+};
+
+/**
+ * @brief Remove spaces and tabs from both ends.
+ */
+static std::string_view trim(std::string_view s)
+{
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+    return s;
+}
+
+static bool directiveEquals(std::string_view directive, std::string_view name)
+{
+    return directive.size() == name.size() && strncasecmp(directive.data(), name.data(), name.size()) == 0;
+}
+
+/**
+ * @brief Apply the directives of a Cache-Control response header. s-maxage is
+ * meant for shared caches and wins over max-age.
+ */
+static void applyCacheControl(std::string_view rest, Freshness &freshness)
+{
+    bool sharedMaxAge = false;
+
+    while (!rest.empty())
+    {
+        size_t end = rest.find(',');
+        std::string_view directive = trim(rest.substr(0, end));
+        rest = end == std::string_view::npos ? std::string_view{} : rest.substr(end + 1);
+
+        size_t eq = directive.find('=');
+        std::string_view name = trim(directive.substr(0, eq));
+        std::string_view value = eq == std::string_view::npos ? std::string_view{} : trim(directive.substr(eq + 1));
+
+        if (value.size() >= 2 && value.front() == '"' && value.back() == '"')
+            value = value.substr(1, value.size() - 2);
+
+        long seconds = -1;
+        std::from_chars(value.data(), value.data() + value.size(), seconds);
+
+        if (directiveEquals(name, "no-store") || directiveEquals(name, "no-cache") || directiveEquals(name, "private"))
+        {
+            freshness.storable = false;
+        }
+        else if (directiveEquals(name, "s-maxage") && seconds >= 0)
+        {
+            freshness.ttl = std::chrono::seconds(seconds);
+            sharedMaxAge = true;
+        }
+        else if (directiveEquals(name, "max-age") && seconds >= 0 && !sharedMaxAge)
+        {
+            freshness.ttl = std::chrono::seconds(seconds);
+        }
+        else if (directiveEquals(name, "stale-while-revalidate") && seconds >= 0)
+        {
+            freshness.staleWhileRevalidate = std::chrono::seconds(seconds);
+        }
+    }
+}
+
+static bool isCacheableStatus(uint16_t status)
+{
+    switch (status)
+    {
+    case 200: case 203: case 204: case 301: case 404: case 410:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool isCacheableRequest(const HttpRequest &req)
+{
+    return (req.method() == "GET" || req.method() == "HEAD") && !req.headers().headerExists(HeaderId::Authorization);
+}
+
+/**
+ * @brief Build the key from the method, the URI and the vary headers. The parts
+ * are separated by characters that can't occur in them.
+ */
+static std::string makeKey(const HttpRequest &req, const std::vector<std::string> &varyHeaders)
+{
+    std::string key;
+    key.reserve(req.method().size() + req.uri().size() + 16);
+
+    key += req.method();
+    key += ' ';
+    key += req.uri();
+
+    for (const auto &name : varyHeaders)
+    {
+        key += '\n';
+        key += req.headers().getValueOrEmpty(name);
+    }
+
+    return key;
+}
+
+/**
+ * @brief Check if the handler's response may be sent to other clients, and for 
+ * how long. Responses with a status that is not cacheable, with Set-Cookie or 
+ * with no-store, no-cache or private are not storable.
+ */
+static Freshness responseFreshness(HttpResponse &res, std::chrono::milliseconds ttl, 
+    std::chrono::milliseconds staleWhileRevalidate)
+{
+    HttpHeaders &headers = res.getHeadersWritable();
+
+    Freshness freshness{true, ttl, staleWhileRevalidate};
+
+    if (!isCacheableStatus(res.getStatus()) || headers.headerExists(HeaderId::SetCookie))
+    {
+        freshness.storable = false;
+        return freshness;
+    }
+
+    headers.forEachValue(HeaderId::CacheControl, [&freshness](std::string_view value) {
+        applyCacheControl(value, freshness);
+    });
+
+    return freshness;
+}
+
+/**
+ * @brief Store the captured response if the handler's response allows it.
+ */
+static void storeResponse(ResponseCache &cache, const std::string &key, std::string &&captured,
+    HttpResponse &res, const ResponseCacheOptions &options)
+{
+    if (captured.empty())
+        return;
+
+    Freshness freshness = responseFreshness(res, options.ttl, options.staleWhileRevalidate);
+
+    if (!freshness.storable || freshness.ttl.count() <= 0)
+        return;
+
+    auto now = CachedResponse::Clock::now();
+
+    cache.put(key, std::make_shared<const CachedResponse>(std::move(captured), res.getStatus(),
+        now + freshness.ttl, now + freshness.ttl + freshness.staleWhileRevalidate));
+}
+
+/**
+ * @brief Run the handler and capture everything it sends. A capture of an outer 
+ * wrapper still gets all the data.
+ */
+static HttpRouteHandling runCaptured(const HttpHandlerFn &handler, const HttpRequest &req, HttpResponse &res, 
+    std::string &captured)
+{
+    std::string *outer = res.captureTo(&captured);
+
+    HttpRouteHandling handling;
+
+    try
+    {
+        handling = handler(req, res);
+    }
+    catch (...)
+    {
+        res.captureTo(outer);
+        if (outer) outer->append(captured);
+        throw;
+    }
+
+    res.captureTo(outer);
+    if (outer) outer->append(captured);
+
+    return handling;
+}
+
+HttpRoute cacheResponses(HttpRoute route, const ResponseCacheOptions &options)
+{
+    auto cache = std::make_shared<ResponseCache>(options.cacheBytes, options.maxResponseSize);
+
+    route.wrapHandler([cache, options](HttpHandlerFn handler) -> HttpHandlerFn {
+        return [cache, options, handler = std::move(handler)](const HttpRequest &req, HttpResponse &res) {
+
+            if (!isCacheableRequest(req))
+                return handler(req, res);
+
+            std::string key = makeKey(req, options.varyHeaders);
+
+            std::shared_ptr<const CachedResponse> cached = cache->get(key, CachedResponse::Clock::now());
+
+            // A stale response is sent until the one request that refreshes it is done
+            if (cached && (cached->isFresh(CachedResponse::Clock::now()) || !cached->beginRevalidate()))
+            {
+                res.setStatus(cached->getStatus());
+                res.sendRaw((const uint8_t*)cached->data().data(), cached->data().size());
+                return HttpRouteHandling::End;
+            }
+
+            std::string captured;
+
+            HttpRouteHandling handling;
+
+            try
+            {
+                handling = runCaptured(handler, req, res, captured);
+            }
+            catch (...)
+            {
+                if (cached) cached->endRevalidate();
+                throw;
+            }
+
+            if (handling == HttpRouteHandling::End)
+                storeResponse(*cache, key, std::move(captured), res, options);
+
+            // The new response replaced the stale one, unless it wasn't cacheable
+            if (cached) cached->endRevalidate();
+
+            return handling;
+        };
+    });
+
+    return route;
+}
+
+
+/**
+ * @brief The handler run of the first of concurrent identical requests, which 
+ * the others wait for.
+ */
+struct Flight
+{
+    enum class State
+    {
+        Running,
+        Done,
+        /**
+         * @brief The response must not be sent to other clients, so every 
+         * waiting request runs the handler itself.
+         */
+        Unshared,
+        Failed
+    };
+
+    std::mutex mtx;
+
+    std::condition_variable cv;
+
+    /**
+     * @brief Once the state has left Running it never changes again, so the 
+     * result can be read without the lock after waiting.
+     * 
+     * NOTE: The access is not synchronized by default and the mtx mutex must 
+     * be used to access this variable.
+     */
+    State state = State::Running;
+
+    HttpRouteHandling handling = HttpRouteHandling::End;
+
+    uint16_t status = 0;
+
+    std::string response;
+};
+
+/**
+ * @brief The flights that are running for a route, by key.
+ */
+struct FlightTable
+{
+    std::mutex mtx;
+
+    /**
+     * @brief NOTE: The access is not synchronized by default and the mtx mutex must 
+     * be used to access this variable.
+     */
+    std::unordered_map<std::string, std::shared_ptr<Flight>> flights;
+};
+
+/**
+ * @brief Check if the result of the flight may be sent to the waiting requests. 
+ * The same rules as for storing a response in the cache apply, except for the 
+ * TTL. A Continue without a response is routed the same way by every request.
+ */
+static bool isShareable(const Flight &flight, HttpResponse &res)
+{
+    if (flight.handling != HttpRouteHandling::End)
+        return flight.response.empty();
+
+    return !flight.response.empty() 
+        && responseFreshness(res, std::chrono::milliseconds(0), std::chrono::milliseconds(0)).storable;
+}
+
+/**
+ * @brief Requests with a cookie may get a personalized response, so they are only
+ * coalesced if the cookie is part of the key.
+ */
+static bool isCoalescableRequest(const HttpRequest &req, const std::vector<std::string> &varyHeaders)
+{
+    if (!isCacheableRequest(req))
+        return false;
+
+    if (!req.headers().headerExists(HeaderId::Cookie))
+        return true;
+
+    return std::any_of(varyHeaders.begin(), varyHeaders.end(), [](const std::string &name) {
+        return strcasecmp(name.c_str(), HttpHeader::Cookie.c_str()) == 0;
+    });
+}
+
+/**
+ * @brief Publish the result of the flight and wake up the waiting requests.
+ */
+static void landFlight(FlightTable &table, const std::string &key, Flight &flight, Flight::State state)
+{
+    // Requests that arrive from now on start a new flight
+    {
+        std::lock_guard<std::mutex> lock(table.mtx);
+        table.flights.erase(key);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(flight.mtx);
+        flight.state = state;
+    }
+
+    flight.cv.notify_all();
+}
+
+HttpRoute coalesceRequests(HttpRoute route, const CoalescingOptions &options)
+{
+    auto table = std::make_shared<FlightTable>();
+
+    route.wrapHandler([table, options](HttpHandlerFn handler) -> HttpHandlerFn {
+        return [table, options, handler = std::move(handler)](const HttpRequest &req, HttpResponse &res) {
+
+            if (!isCoalescableRequest(req, options.varyHeaders))
+                return handler(req, res);
+
+            std::string key = makeKey(req, options.varyHeaders);
+
+            // If the first request fails, one of the waiting requests runs the 
+            // handler next
+            while (true)
+            {
+                std::shared_ptr<Flight> flight;
+                bool first = false;
+
+                {
+                    std::lock_guard<std::mutex> lock(table->mtx);
+
+                    std::shared_ptr<Flight> &slot = table->flights[key];
+
+                    if (!slot)
+                    {
+                        slot = std::make_shared<Flight>();
+                        first = true;
+                    }
+
+                    flight = slot;
+                }
+
+                if (first)
+                {
+                    HttpRouteHandling handling;
+
+                    try
+                    {
+                        handling = runCaptured(handler, req, res, flight->response);
+                    }
+                    catch (...)
+                    {
+                        landFlight(*table, key, *flight, Flight::State::Failed);
+                        throw;
+                    }
+
+                    flight->handling = handling;
+                    flight->status = res.getStatus();
+
+                    landFlight(*table, key, *flight, 
+                        isShareable(*flight, res) ? Flight::State::Done : Flight::State::Unshared);
+
+                    return handling;
+                }
+
+                {
+                    std::unique_lock<std::mutex> lock(flight->mtx);
+                    flight->cv.wait(lock, [&flight] { return flight->state != Flight::State::Running; });
+
+                    if (flight->state == Flight::State::Failed)
+                        continue;
+                }
+
+                // Run the handler without coalescing, another flight would most 
+                // likely not be shareable either
+                if (flight->state == Flight::State::Unshared)
+                    return handler(req, res);
+
+                // An identical request is routed the same way, including Continue
+                if (flight->handling == HttpRouteHandling::End)
+                {
+                    res.setStatus(flight->status);
+                    res.sendRaw((const uint8_t*)flight->response.data(), flight->response.size());
+                }
+
+                return flight->handling;
+            }
+        };
+    });
+
+    return route;
+}
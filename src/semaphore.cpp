@@ -7,91 +7,163 @@
 #include "semaphore.hpp"
 
 #include <stdexcept>
+#include <thread>
 #include <ctime>
 
+#include "futex.hpp"
 
-Semaphore::Semaphore(int initialValue)
+/**
+ * @brief Tell the cpu that this is a spin loop. This reduces the power usage and
+ * frees execution units for the SMT sibling while spinning.
+ */
+static inline void cpuRelax()
 {
-    _semaphore = new sem_t;
-    sem_init(_semaphore, 0, initialValue);
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
 }
 
-Semaphore::Semaphore(Semaphore && other)
-    : _semaphore{other._semaphore}
+
+Semaphore::Semaphore(int initialValue)
+    : _value{(uint32_t)initialValue}
 {
-    other._semaphore = nullptr;
+    if (initialValue < 0)
+        throw std::runtime_error("Semaphore initial value can't be less than 0");
 }
 
+Semaphore::Semaphore(Semaphore && other)
+    : _value{other._value.exchange(0)}
+{ }
+
 Semaphore & Semaphore::operator=(Semaphore && other)
 {
     if (&other != this)
     {
-        sem_destroy(_semaphore);
-        delete _semaphore;
-
-        _semaphore = other._semaphore;
-        other._semaphore = nullptr;
+        _value.store(other._value.exchange(0));
     }
     return *this;
 }
 
-Semaphore::~Semaphore()
+void Semaphore::post()
 {
-    sem_destroy(_semaphore);
-    delete _semaphore;
+    // The seq_cst increment orders the new value before the waiter check. This
+    // pairs with the seq_cst increment of _waiters in wait()
+    _value.fetch_add(1, std::memory_order_seq_cst);
+
+    if (_waiters.load(std::memory_order_seq_cst) != 0)
+    {
+        futexWake(&_value, 1);
+    }
 }
 
-void Semaphore::post()
+/**
+ * @brief Spinning only helps if the thread that posts can run at the same time.
+ * On a single cpu it only delays the poster.
+ */
+static bool isSpinningUseful()
 {
-    if (_semaphore == nullptr) 
-        throw std::runtime_error("Semaphore used after move");
+    static const bool useful = std::thread::hardware_concurrency() > 1;
+    return useful;
+}
+
+bool Semaphore::spinWait()
+{
+    if (!isSpinningUseful())
+        return false;
+
+    for (int i = 0; i < SPIN_ITERATIONS; i++)
+    {
+        if (_value.load(std::memory_order_relaxed) != 0 && tryWait())
+            return true;
 
-    sem_post(_semaphore);
+        cpuRelax();
+    }
+
+    return false;
 }
 
 void Semaphore::wait()
 {
-    if (_semaphore == nullptr) 
-        throw std::runtime_error("Semaphore used after move");
+    if (tryWait() || spinWait())
+        return;
+
+    _waiters.fetch_add(1, std::memory_order_seq_cst);
+
+    // The kernel only puts the thread to sleep if the value is still 0, so a
+    // post between tryWait and futexWait is not lost
+    while (!tryWait())
+    {
+        futexWait(&_value, 0);
+    }
 
-    sem_wait(_semaphore);
+    _waiters.fetch_sub(1, std::memory_order_relaxed);
 }
 
 bool Semaphore::tryWait()
 {
-    if (_semaphore == nullptr) 
-        throw std::runtime_error("Semaphore used after move");
+    uint32_t v = _value.load(std::memory_order_relaxed);
 
-    return (sem_trywait(_semaphore) == 0);
+    while (v != 0)
+    {
+        if (_value.compare_exchange_weak(v, v - 1, std::memory_order_acquire, std::memory_order_relaxed))
+            return true;
+    }
+
+    return false;
 }
 
 bool Semaphore::timedWait(long ms)
 {
-    if (_semaphore == nullptr) 
-        throw std::runtime_error("Semaphore used after move");
-    
-    // Split the milliseconds into full seconds and leftover nanoseconds
-    int secs = ms / 1000;
-    int nsecs = (ms % 1000) * 1000000L;
+    if (tryWait() || spinWait())
+        return true;
 
-    timespec ts;
+    // Absolute deadline on the monotonic clock, the futex timeout is relative
+    // and is recalculated after every wakeup
+    timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
 
-    // sem_timedwait need the absolute timestamp when to stop waiting, so get 
-    // the current timestamp and add the wait time.
-    clock_gettime(CLOCK_REALTIME, &ts);
+    deadline.tv_sec += ms / 1000;
+    deadline.tv_nsec += (ms % 1000) * 1000000L;
+
+    if (deadline.tv_nsec >= 1000000000L)
+    {
+        deadline.tv_sec += 1;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    _waiters.fetch_add(1, std::memory_order_seq_cst);
+
+    bool decremented = false;
+
+    while (!(decremented = tryWait()))
+    {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        timespec remaining;
+        remaining.tv_sec = deadline.tv_sec - now.tv_sec;
+        remaining.tv_nsec = deadline.tv_nsec - now.tv_nsec;
+
+        if (remaining.tv_nsec < 0)
+        {
+            remaining.tv_sec -= 1;
+            remaining.tv_nsec += 1000000000L;
+        }
+
+        if (remaining.tv_sec < 0)
+            break;
+
+        futexWait(&_value, 0, &remaining);
+    }
 
-    ts.tv_sec += secs;
-    ts.tv_nsec += nsecs;
+    _waiters.fetch_sub(1, std::memory_order_relaxed);
 
-    return (sem_timedwait(_semaphore, &ts) == 0);
+    return decremented;
 }
 
 int Semaphore::getValue()
 {
-    if (_semaphore == nullptr) 
-        throw std::runtime_error("Semaphore used after move");
-    
-    int val;
-    sem_getvalue(_semaphore, &val);
-    return val;
+    return _value.load(std::memory_order_relaxed);
 }
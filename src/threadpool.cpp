@@ -1,7 +1,23 @@
 #include "threadpool.hpp"
 
-Threadpool::Threadpool(int _numberOfWorkers, int _maxQueueBacklog)
-    : numberOfWorkers{_numberOfWorkers}, maxQueueBacklog{_maxQueueBacklog}
+#include <pthread.h>
+#include <sched.h>
+
+#include "cpu_topology.hpp"
+
+/**
+ * @brief The threadpool that the current thread is a worker of, or nullptr if
+ * the thread is not a worker thread.
+ */
+static thread_local Threadpool *currentThreadpool = nullptr;
+
+/**
+ * @brief The worker id of the current thread in currentThreadpool.
+ */
+static thread_local int currentWorkerId = -1;
+
+Threadpool::Threadpool(int _numberOfWorkers, int _maxQueueBacklog, Scheduling _scheduling)
+    : scheduling{_scheduling}, numberOfWorkers{_numberOfWorkers}, maxQueueBacklog{_maxQueueBacklog}
 {
 
     if (numberOfWorkers < 0)
@@ -16,108 +32,909 @@ Threadpool::Threadpool(int _numberOfWorkers, int _maxQueueBacklog)
 
     if (numberOfWorkers == AUTO_NO_WORKERS)
     {
-        // Get the hardware concurrency (number of logical cpu cores) and create half
-        // as many worker threads. If there is hyperthreading, the number of logical cores 
-        // is double the amount of physical cores. So on a modern machine with hyperthreading
-        // the number of worker threads will be equivalent to the number of "real" cpu cores
-        numberOfWorkers = std::thread::hardware_concurrency() / 2;
+        // Create one worker per physical core. SMT siblings share the execution 
+        // units of their core, so more workers than cores don't add throughput
+        numberOfWorkers = CpuTopology::discover().getPhysicalCores().size();
 
         if (numberOfWorkers < 1) numberOfWorkers = 1;
     }
 
-    if (maxQueueBacklog != DISABLE_MAX_QUEUE_BACKLOG)
+    // The ring is exactly as large as the backlog limit, so a full ring means 
+    // the limit is reached
+    taskQueue = std::make_unique<MpmcQueue<QueuedTask>>(
+        maxQueueBacklog == DISABLE_MAX_QUEUE_BACKLOG ? (size_t)UNLIMITED_QUEUE_RING_SIZE : (size_t)maxQueueBacklog
+    );
+
+    if (scheduling == Scheduling::WorkStealing)
     {
-        // Change the initial semaphore value if the max queue backlog is not unlimited
-        semTaskQueueLimit = Semaphore(maxQueueBacklog);
+        // The deques must exist before any worker starts stealing
+        for (auto i = 0; i < numberOfWorkers; i++)
+        {
+            workerQueues.push_back(std::make_unique<WorkerQueue>());
+        }
     }
 
     // Create the requested number of worker threads
-    for (auto i = 0; i < numberOfWorkers; i++)
     {
-        workerThreads.push_back(
-            std::thread(&Threadpool::workLoop, this, i)
-        );
+        std::unique_lock<std::mutex> lock(mtxWorkers);
+
+        for (auto i = 0; i < numberOfWorkers; i++)
+        {
+            startWorker();
+        }
+    }
+}
+
+Threadpool::~Threadpool()
+{
+    // Destroying a joinable std::thread terminates the process
+    shutdown();
+    joinAll();
+}
+
+void Threadpool::startWorker()
+{
+    // Reuse the slot of a retired worker if there is one
+    size_t slot = 0;
+    while (slot < workerThreads.size() && !workerRetired[slot]) slot++;
+
+    if (slot < workerThreads.size())
+    {
+        // The retired worker has already left its loop, so this doesn't block long
+        if (workerThreads[slot].joinable()) workerThreads[slot].join();
+        workerRetired[slot] = false;
+    }
+    else
+    {
+        workerThreads.emplace_back();
+        workerRetired.push_back(false);
+    }
+
+    workerThreads[slot] = std::thread(
+        scheduling == Scheduling::WorkStealing ? &Threadpool::workLoopStealing : &Threadpool::workLoop,
+        this, (int)slot
+    );
+
+    applyAffinity(slot, workerThreads[slot]);
+
+    activeWorkers.fetch_add(1);
+}
+
+void Threadpool::growIfAllowed()
+{
+    // Cheap check first, this is called for every delayed task
+    if (activeWorkers.load(std::memory_order_relaxed) >= elasticLimits.maxWorkers)
+    {
+        return;
+    }
+
+    int oldSize, newSize;
+
+    {
+        // If another thread is resizing right now, there is no need to grow again
+        std::unique_lock<std::mutex> lock(mtxWorkers, std::try_to_lock);
+        if (!lock.owns_lock()) return;
+
+        auto now = std::chrono::steady_clock::now();
+
+        if (shutdownInitiated.load() 
+            || activeWorkers.load() >= elasticLimits.maxWorkers 
+            || now - lastGrow < elasticLimits.growCooldown)
+        {
+            return;
+        }
+
+        oldSize = activeWorkers.load();
+        startWorker();
+        newSize = activeWorkers.load();
+
+        lastGrow = now;
+        lastResize = now;
+    }
+
+    resizeEvents.fetch_add(1, std::memory_order_relaxed);
+
+    if (resizeCallback) resizeCallback(oldSize, newSize);
+}
+
+void Threadpool::growIfBacklogged(std::chrono::steady_clock::time_point now)
+{
+    int64_t ticks = now.time_since_epoch().count();
+
+    if (taskQueue->sizeApprox() == 0 && overflowTasks.load(std::memory_order_relaxed) <= 0)
+    {
+        // The new task starts a backlog, the workers haven't had a chance to 
+        // take it yet
+        lastQueueProgress.store(ticks, std::memory_order_relaxed);
+        return;
+    }
+
+    std::chrono::steady_clock::duration sinceProgress(ticks - lastQueueProgress.load(std::memory_order_relaxed));
+
+    if (sinceProgress > elasticLimits.growDelay)
+    {
+        growIfAllowed();
     }
 }
 
+void Threadpool::waitForSpace(uint32_t key)
+{
+    if (!elastic.load(std::memory_order_relaxed))
+    {
+        evSpaceAvailable.wait(key);
+        return;
+    }
+
+    long ms = std::max<long>(1, std::chrono::duration_cast<std::chrono::milliseconds>(elasticLimits.growDelay).count());
+
+    if (!evSpaceAvailable.timedWait(key, ms))
+    {
+        growIfBacklogged(std::chrono::steady_clock::now());
+    }
+}
+
+bool Threadpool::retireIfAllowed(int workerId)
+{
+    int oldSize, newSize;
+
+    {
+        std::unique_lock<std::mutex> lock(mtxWorkers);
+
+        auto now = std::chrono::steady_clock::now();
+
+        // During a shutdown the workers end through the normal shutdown logic
+        if (shutdownInitiated.load()
+            || activeWorkers.load() <= elasticLimits.minWorkers 
+            || now - lastResize < elasticLimits.shrinkCooldown)
+        {
+            return false;
+        }
+
+        oldSize = activeWorkers.fetch_sub(1);
+        newSize = oldSize - 1;
+        workerRetired[workerId] = true;
+
+        lastResize = now;
+    }
+
+    // The timed out wait might have swallowed a notification for a task that 
+    // was added just now. Pass it on to one of the remaining workers
+    evTaskAvailable.notifyOne();
+
+    resizeEvents.fetch_add(1, std::memory_order_relaxed);
+
+    if (resizeCallback) resizeCallback(oldSize, newSize);
+
+    return true;
+}
+
 void Threadpool::workLoop(int workerId)
 {
-    // The task function that is received from the task queue
-    std::function<void ()> taskFunction;
+    // The tasks that are received from the task queue. Under load, a worker 
+    // takes several tasks at once to save synchronization
+    Task batch[TASK_BATCH_SIZE];
 
     while (true)
     {
-        // Wait until a task is available in the task queue
-        semWaitForTask.wait();
+        size_t count = takeQueuedTasks(batch, batchSizeForWorker());
 
-        // synchronize taskQueue
+        if (count == 0)
         {
-            std::unique_lock<std::mutex> lock(mtxTaskQueue);
+            // The queue is empty, prepare to sleep and check again to not miss a 
+            // task that was added in the meantime
+            uint32_t key = evTaskAvailable.prepareWait();
 
-            // Graceful shutdown is initiated by posting the sem without new tasks.
-            // This will cause remaining tasks to be processed and then shuts down
-            // the threads.
-            if (taskQueue.empty())
+            count = takeQueuedTasks(batch, batchSizeForWorker());
+
+            if (count == 0)
             {
-                return;
+                // Graceful shutdown. All remaining tasks have been processed, so
+                // the worker can terminate
+                if (shutdownInitiated.load())
+                {
+                    evTaskAvailable.cancelWait();
+                    return;
+                }
+
+                // Wait until a task is available in the task queue. In elastic
+                // mode, workers that stay idle for too long retire
+                if (elastic.load(std::memory_order_acquire))
+                {
+                    if (!evTaskAvailable.timedWait(key, elasticLimits.idleTimeout.count()) 
+                        && retireIfAllowed(workerId))
+                    {
+                        return;
+                    }
+                }
+                else
+                {
+                    evTaskAvailable.wait(key);
+                }
+
+                continue;
             }
 
-            // Get the next task
-            taskFunction = taskQueue.front();
-            // And pop it from the queue
-            taskQueue.pop();
+            evTaskAvailable.cancelWait();
+        }
+
+        // Execute the tasks blocking and release their captures right away
+        for (size_t i = 0; i < count; i++)
+        {
+            batch[i]();
+            batch[i].reset();
+        }
+
+    }
+
+}
+
+size_t Threadpool::batchSizeForWorker() const
+{
+    size_t workers = std::max(1, activeWorkers.load(std::memory_order_relaxed));
+    size_t share = taskQueue->sizeApprox() / workers;
+
+    return std::clamp<size_t>(share, 1, (size_t)TASK_BATCH_SIZE);
+}
+
+bool Threadpool::takeQueuedTask(Task &task)
+{
+    return takeQueuedTasks(&task, 1) == 1;
+}
+
+size_t Threadpool::takeQueuedTasks(Task *tasks, size_t max)
+{
+    QueuedTask items[TASK_BATCH_SIZE];
+
+    size_t count = taskQueue->tryPopBulk(items, std::min(max, (size_t)TASK_BATCH_SIZE));
+
+    if (count > 0)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            tasks[i] = std::move(items[i].task);
+        }
+
+        // Tasks that waited too long in the queue mean that there are not 
+        // enough workers. The first task of the batch waited the longest
+        if (elastic.load(std::memory_order_acquire))
+        {
+            auto now = std::chrono::steady_clock::now();
+
+            lastQueueProgress.store(now.time_since_epoch().count(), std::memory_order_relaxed);
 
+            if (now - items[0].enqueued > elasticLimits.growDelay)
+            {
+                growIfAllowed();
+            }
         }
 
-        // If there is a queue backlog limit, notify to addTask that a task has
-        // been removed from the queue and therefore one more slot is available
+        // If there is a queue backlog limit, notify to addTask that tasks have
+        // been removed from the queue and therefore more slots are available
         if (maxQueueBacklog != DISABLE_MAX_QUEUE_BACKLOG)
         {
-            semTaskQueueLimit.post();
+            evSpaceAvailable.notifyMany(count);
+        }
+
+        return count;
+    }
+
+    // Avoid the lock if nothing overflowed, which is the normal case
+    if (overflowTasks.load(std::memory_order_acquire) <= 0)
+    {
+        return 0;
+    }
+
+    // synchronize overflowQueue
+    {
+        std::unique_lock<std::mutex> lock(mtxOverflowQueue);
+
+        while (count < max && !overflowQueue.empty())
+        {
+            tasks[count++] = std::move(overflowQueue.front().task);
+            overflowQueue.pop();
         }
 
-        // Execute the task blocking
-        taskFunction();
+        overflowTasks.fetch_sub(count, std::memory_order_relaxed);
+    }
 
+    if (count > 0 && elastic.load(std::memory_order_acquire))
+    {
+        lastQueueProgress.store(std::chrono::steady_clock::now().time_since_epoch().count(), 
+            std::memory_order_relaxed);
     }
 
+    return count;
 }
 
-void Threadpool::addTask(std::function<void ()> task)
+bool Threadpool::enqueueTask(Task &&task, bool blocking)
 {
+    QueuedTask item;
+    item.task = std::move(task);
+
+    if (elastic.load(std::memory_order_relaxed))
+    {
+        item.enqueued = std::chrono::steady_clock::now();
+        growIfBacklogged(item.enqueued);
+    }
+
+    if (maxQueueBacklog == DISABLE_MAX_QUEUE_BACKLOG)
+    {
+        // Once tasks went to the overflow queue, new tasks must queue up behind 
+        // them to keep the fifo order
+        if (overflowTasks.load(std::memory_order_acquire) == 0 && taskQueue->tryPush(std::move(item)))
+        {
+            return true;
+        }
+
+        // synchronize overflowQueue
+        {
+            std::unique_lock<std::mutex> lock(mtxOverflowQueue);
+            overflowQueue.push(std::move(item));
+            overflowTasks.fetch_add(1, std::memory_order_release);
+        }
+
+        return true;
+    }
+
+    // The queue is full if the backlog limit is reached, wait until a worker 
+    // took a task
+    while (!taskQueue->tryPush(std::move(item)))
+    {
+        if (!blocking)
+        {
+            // Hand the task back to the caller untouched
+            task = std::move(item.task);
+            return false;
+        }
+
+        uint32_t key = evSpaceAvailable.prepareWait();
+
+        if (taskQueue->tryPush(std::move(item)))
+        {
+            evSpaceAvailable.cancelWait();
+            break;
+        }
+
+        waitForSpace(key);
+    }
+
+    return true;
+}
+
+void Threadpool::enqueueTasks(QueuedTask *items, size_t count)
+{
+    if (elastic.load(std::memory_order_relaxed))
+    {
+        auto now = std::chrono::steady_clock::now();
+
+        for (size_t i = 0; i < count; i++)
+        {
+            items[i].enqueued = now;
+        }
+
+        growIfBacklogged(now);
+    }
+
+    if (maxQueueBacklog == DISABLE_MAX_QUEUE_BACKLOG)
+    {
+        size_t added = 0;
+
+        // Once tasks went to the overflow queue, new tasks must queue up behind 
+        // them to keep the fifo order
+        if (overflowTasks.load(std::memory_order_acquire) == 0)
+        {
+            added = taskQueue->tryPushBulk(items, count);
+        }
+
+        if (added < count)
+        {
+            // synchronize overflowQueue
+            std::unique_lock<std::mutex> lock(mtxOverflowQueue);
+
+            for (size_t i = added; i < count; i++)
+            {
+                overflowQueue.push(std::move(items[i]));
+            }
+
+            overflowTasks.fetch_add(count - added, std::memory_order_release);
+        }
+
+        evTaskAvailable.notifyMany(count);
+        return;
+    }
+
+    size_t added = 0;
+
+    while (added < count)
+    {
+        size_t pushed = taskQueue->tryPushBulk(items + added, count - added);
+
+        if (pushed > 0)
+        {
+            // Wake the workers for this part right away. They must be able to 
+            // start on it, otherwise the queue never gets space for the rest
+            added += pushed;
+            evTaskAvailable.notifyMany(pushed);
+            continue;
+        }
+
+        // The queue is full if the backlog limit is reached, wait until a worker 
+        // took a task
+        uint32_t key = evSpaceAvailable.prepareWait();
+
+        pushed = taskQueue->tryPushBulk(items + added, count - added);
+
+        if (pushed > 0)
+        {
+            evSpaceAvailable.cancelWait();
+            added += pushed;
+            evTaskAvailable.notifyMany(pushed);
+            continue;
+        }
+
+        waitForSpace(key);
+    }
+}
+
+void Threadpool::addTaskBatch(QueuedTask *items, size_t count)
+{
+    if (scheduling == Scheduling::WorkStealing && currentThreadpool == this)
+    {
+        // Tasks spawned by a worker go onto its own deque
+        for (size_t i = 0; i < count; i++)
+        {
+            pushLocalTask(std::move(items[i].task));
+        }
+        return;
+    }
+
     if (shutdownInitiated)
     {
         throw std::runtime_error("Can't add task to threadpool after shutdown");
     }
-    
-    // If there is a queue backlog limit, wait until the queue is no longer full
-    if (maxQueueBacklog != DISABLE_MAX_QUEUE_BACKLOG)
+
+    if (scheduling == Scheduling::WorkStealing)
     {
-        semTaskQueueLimit.wait();
+        pendingTasks.fetch_add(count, std::memory_order_relaxed);
     }
 
-    // synchronize taskQueue
+    enqueueTasks(items, count);
+}
+
+Threadpool::TaskSlot * Threadpool::WorkerQueue::acquireSlot()
+{
+    if (!freeSlots)
+    {
+        // Slots that other workers ran. Only the owner takes from the list and it 
+        // takes everything, so there is no ABA problem
+        freeSlots = returnedSlots.exchange(nullptr, std::memory_order_acquire);
+    }
+
+    if (!freeSlots)
+    {
+        slabs.push_back(std::make_unique<TaskSlot[]>(TASK_SLAB_SIZE));
+        TaskSlot *slab = slabs.back().get();
+
+        for (size_t i = 0; i < TASK_SLAB_SIZE; i++)
+        {
+            slab[i].home = this;
+            slab[i].nextFree = i + 1 < TASK_SLAB_SIZE ? &slab[i + 1] : nullptr;
+        }
+
+        freeSlots = slab;
+    }
+
+    TaskSlot *slot = freeSlots;
+    freeSlots = slot->nextFree;
+    return slot;
+}
+
+void Threadpool::WorkerQueue::releaseSlot(TaskSlot *slot, bool byOwner)
+{
+    if (byOwner)
     {
-        std::unique_lock<std::mutex> lock(mtxTaskQueue);
-        taskQueue.push(task);
+        slot->nextFree = freeSlots;
+        freeSlots = slot;
+        return;
     }
 
+    TaskSlot *head = returnedSlots.load(std::memory_order_relaxed);
+
+    do
+    {
+        slot->nextFree = head;
+    } while (!returnedSlots.compare_exchange_weak(head, slot, 
+        std::memory_order_release, std::memory_order_relaxed));
+}
+
+void Threadpool::pushLocalTask(Task &&task)
+{
+    WorkerQueue &queue = *workerQueues[currentWorkerId];
+
+    TaskSlot *slot = queue.acquireSlot();
+    slot->task = std::move(task);
+
+    // This is allowed even during shutdown, since the running task might depend 
+    // on the spawned tasks
+    pendingTasks.fetch_add(1, std::memory_order_relaxed);
+    queue.deque.push(slot);
+
+    evTaskAvailable.notifyOne();
+}
+
+void Threadpool::runTaskSlot(TaskSlot *slot, int workerId)
+{
+    // Gives the slot back also if the task throws
+    struct SlotRelease
+    {
+        TaskSlot *slot;
+        bool byOwner;
+
+        ~SlotRelease()
+        {
+            // Release the captures now, not when the slot is reused
+            slot->task.reset();
+            slot->home->releaseSlot(slot, byOwner);
+        }
+    };
+
+    SlotRelease release{slot, workerId >= 0 && workerQueues[workerId].get() == slot->home};
+
+    slot->task();
+}
+
+bool Threadpool::runNextTask(int workerId, uint32_t &rng)
+{
+    TaskSlot *localTask;
+
+    // Newest task from the own deque first, it is the most likely to be in cache
+    if (workerId >= 0 && workerQueues[workerId]->deque.pop(localTask))
+    {
+        pendingTasks.fetch_sub(1, std::memory_order_relaxed);
+
+        runTaskSlot(localTask, workerId);
+        return true;
+    }
+
+    // Then tasks that were added from outside of the threadpool
+    Task queuedTask;
+
+    if (takeQueuedTask(queuedTask))
+    {
+        pendingTasks.fetch_sub(1, std::memory_order_relaxed);
+
+        queuedTask();
+        return true;
+    }
+
+    // Then try to steal the oldest task of random other workers
+    for (int attempt = 0; attempt < numberOfWorkers; attempt++)
+    {
+        // xorshift32
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+
+        int victim = rng % numberOfWorkers;
+
+        if (victim == workerId) continue;
+
+        if (workerQueues[victim]->deque.steal(localTask))
+        {
+            pendingTasks.fetch_sub(1, std::memory_order_relaxed);
+
+            runTaskSlot(localTask, workerId);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void Threadpool::workLoopStealing(int workerId)
+{
+    currentThreadpool = this;
+    currentWorkerId = workerId;
+
+    // Seed for picking steal victims, must not be 0 for xorshift
+    uint32_t rng = 2654435761u * (workerId + 1);
+
+    while (true)
+    {
+        if (runNextTask(workerId, rng))
+        {
+            continue;
+        }
+
+        // Nothing found, prepare to park and check again to not miss a task that
+        // was added in the meantime
+        uint32_t key = evTaskAvailable.prepareWait();
+
+        if (pendingTasks.load(std::memory_order_seq_cst) > 0)
+        {
+            evTaskAvailable.cancelWait();
+            continue;
+        }
+
+        // All tasks are done, so the worker can end if a shutdown was requested
+        if (shutdownInitiated.load())
+        {
+            evTaskAvailable.cancelWait();
+            return;
+        }
+
+        evTaskAvailable.wait(key);
+    }
+}
+
+void Threadpool::addTask(Task &&task)
+{
+    if (scheduling == Scheduling::WorkStealing && currentThreadpool == this)
+    {
+        // Tasks spawned by a worker go onto its own deque
+        pushLocalTask(std::move(task));
+        return;
+    }
+
+    if (shutdownInitiated)
+    {
+        throw std::runtime_error("Can't add task to threadpool after shutdown");
+    }
+
+    if (scheduling == Scheduling::WorkStealing)
+    {
+        pendingTasks.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // If there is a queue backlog limit, this blocks until the queue is no longer full
+    enqueueTask(std::move(task), true);
+
     // Notify worker pool that a new task is available
-    semWaitForTask.post();
+    evTaskAvailable.notifyOne();
+}
+
+bool Threadpool::tryAddTask(Task &&task)
+{
+    if (scheduling == Scheduling::WorkStealing && currentThreadpool == this)
+    {
+        pushLocalTask(std::move(task));
+        return true;
+    }
+
+    if (shutdownInitiated)
+    {
+        throw std::runtime_error("Can't add task to threadpool after shutdown");
+    }
+
+    if (scheduling == Scheduling::WorkStealing)
+    {
+        pendingTasks.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (!enqueueTask(std::move(task), false))
+    {
+        if (scheduling == Scheduling::WorkStealing)
+        {
+            pendingTasks.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        return false;
+    }
+
+    evTaskAvailable.notifyOne();
+    return true;
+}
+
+void TaskFutureBase::wait() const
+{
+    if (!stateBase)
+    {
+        throw std::runtime_error("TaskFuture has no task");
+    }
+
+    // A task that no worker has started yet is run right here, this prevents 
+    // deadlocks when all workers wait for queued results
+    if (stateBase->tryRun())
+    {
+        return;
+    }
+
+    // The task is running on another thread
+    while (!stateBase->done.isSet())
+    {
+        stateBase->done.wait();
+    }
+}
+
+void Threadpool::runParallelChunks(ParallelForState &state)
+{
+    while (true)
+    {
+        size_t chunk = state.nextChunk.fetch_add(1, std::memory_order_relaxed);
+
+        if (chunk >= state.chunks)
+        {
+            return;
+        }
+
+        size_t chunkBegin = state.begin + chunk * state.grain;
+        size_t chunkEnd = std::min(chunkBegin + state.grain, state.end);
+
+        try
+        {
+            state.runChunk(state.body, chunkBegin, chunkEnd);
+        }
+        catch (...)
+        {
+            if (!state.failed.exchange(true))
+            {
+                state.exception = std::current_exception();
+            }
+        }
+
+        if (state.finishedChunks.fetch_add(1, std::memory_order_acq_rel) + 1 == state.chunks)
+        {
+            state.done.set();
+        }
+    }
+}
+
+void Threadpool::runParallelFor(const std::shared_ptr<ParallelForState> &state)
+{
+    // One helper per worker is enough, since the helpers keep claiming chunks. 
+    // Helpers that start after all chunks were claimed only hold on to the 
+    // state and return right away, the body isn't touched by them anymore
+    size_t helpers = std::min<size_t>(state->chunks - 1, activeWorkers.load());
+
+    for (size_t i = 0; i < helpers; i++)
+    {
+        // If the queue is full, the calling thread does the remaining work
+        if (!tryAddTask([state]() { runParallelChunks(*state); }))
+        {
+            break;
+        }
+    }
+
+    runParallelChunks(*state);
+
+    // All chunks are claimed at this point, so the remaining ones are running on
+    // other threads and will finish without help
+    while (!state->done.isSet())
+    {
+        state->done.wait();
+    }
+
+    if (state->exception)
+    {
+        std::rethrow_exception(state->exception);
+    }
+}
+
+bool Threadpool::applyAffinity(int workerId, std::thread &thread)
+{
+    if (affinityCpus.empty())
+    {
+        return true;
+    }
+
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+
+    if (affinityPerWorker)
+    {
+        CPU_SET(affinityCpus[workerId % affinityCpus.size()], &cpuset);
+    }
+    else
+    {
+        for (int cpu : affinityCpus)
+            CPU_SET(cpu, &cpuset);
+    }
+
+    return pthread_setaffinity_np(thread.native_handle(), sizeof(cpuset), &cpuset) == 0;
+}
+
+bool Threadpool::pinWorkers(const std::vector<int> &cpus, bool onePerWorker)
+{
+    for (int cpu : cpus)
+    {
+        if (cpu < 0 || cpu >= CPU_SETSIZE)
+        {
+            throw std::runtime_error("Threadpool can't pin workers to cpu " + std::to_string(cpu));
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(mtxWorkers);
+
+    // Stored for workers that are started later in elastic mode
+    affinityCpus = cpus;
+    affinityPerWorker = onePerWorker;
+
+    bool allPinned = true;
+
+    for (size_t i = 0; i < workerThreads.size(); i++)
+    {
+        if (workerRetired[i] || !workerThreads[i].joinable()) continue;
+
+        allPinned = applyAffinity(i, workerThreads[i]) && allPinned;
+    }
+
+    return allPinned;
 }
 
 void Threadpool::shutdown()
 {
     shutdownInitiated = true;
 
-    // Post once for every worker thread. This will cause all tasks to be processed
-    // and after that the workers will terminate
-    for (int i = 0; i < workerThreads.size(); i++)
-        semWaitForTask.post();
+    // Parked workers check for the shutdown after waking up, workers that are
+    // still busy will end once all tasks are done
+    evTaskAvailable.notifyAll();
+}
+
+void Threadpool::enableElasticSizing(const ElasticLimits &limits)
+{
+    if (scheduling != Scheduling::Fifo)
+    {
+        throw std::runtime_error("Threadpool elastic sizing requires fifo scheduling");
+    }
+
+    if (limits.minWorkers < 1 || limits.maxWorkers < limits.minWorkers)
+    {
+        throw std::runtime_error("Threadpool elastic limits must satisfy 1 <= minWorkers <= maxWorkers");
+    }
+
+    std::unique_lock<std::mutex> lock(mtxWorkers);
+
+    elasticLimits = limits;
+
+    while (activeWorkers.load() < limits.minWorkers)
+    {
+        startWorker();
+    }
+
+    lastResize = std::chrono::steady_clock::now();
+    lastQueueProgress.store(lastResize.time_since_epoch().count(), std::memory_order_relaxed);
+
+    elastic.store(true, std::memory_order_release);
+}
+
+void Threadpool::setResizeCallback(ResizeCallback callback)
+{
+    resizeCallback = callback;
+}
+
+int Threadpool::getNumberOfWorkers() const
+{
+    return activeWorkers.load();
+}
+
+uint64_t Threadpool::getResizeEvents() const
+{
+    return resizeEvents.load(std::memory_order_relaxed);
 }
 
 void Threadpool::joinAll()
 {
-    for (auto &t : workerThreads)
-        t.join();
-}
\ No newline at end of file
+    // Join one thread at a time without holding the lock, a worker might still 
+    // need it to retire
+    while (true)
+    {
+        std::thread worker;
+
+        {
+            std::unique_lock<std::mutex> lock(mtxWorkers);
+
+            for (auto &t : workerThreads)
+            {
+                if (t.joinable())
+                {
+                    worker = std::move(t);
+                    break;
+                }
+            }
+        }
+
+        if (!worker.joinable()) return;
+
+        worker.join();
+    }
+}
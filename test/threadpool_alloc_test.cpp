@@ -0,0 +1,175 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <thread>
+
+#include <netinet/in.h>
+
+#include "threadpool.hpp"
+
+/**
+ * Checks that adding and running a task allocates no memory, for a task with
+ * the captures of the accept loop: a pointer, the socket and the remote address.
+ * The pool has a backlog limit like the pool of HttpServer, with an unlimited
+ * backlog the tasks beyond UNLIMITED_QUEUE_RING_SIZE are allocated.
+ *
+ * Also checks that tasks spawned by workers in work stealing mode don't allocate
+ * once the task slots of the workers exist.
+ */
+
+static std::atomic<bool> counting{false};
+
+static std::atomic<uint64_t> allocations{0};
+
+void * operator new(size_t size)
+{
+    if (counting.load(std::memory_order_relaxed))
+        allocations.fetch_add(1, std::memory_order_relaxed);
+
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+static const int CONNECTIONS = 10000;
+
+static const int QUEUED_CONNECTIONS = 5;
+
+/**
+ * @return The number of allocations while CONNECTIONS tasks were added and run.
+ */
+static uint64_t countAllocations(Threadpool::Scheduling scheduling)
+{
+    Threadpool pool(2, QUEUED_CONNECTIONS, scheduling);
+
+    std::atomic<int> handled{0};
+    std::atomic<int> *handledPtr = &handled;
+
+    allocations.store(0);
+    counting.store(true);
+
+    for (int fd = 0; fd < CONNECTIONS; fd++)
+    {
+        sockaddr_in remote = {};
+        remote.sin_port = (in_port_t)fd;
+
+        pool.addTask([handledPtr, fd, remote]() {
+            if (remote.sin_port == (in_port_t)fd)
+                handledPtr->fetch_add(1, std::memory_order_relaxed);
+        });
+    }
+
+    while (handled.load() < CONNECTIONS)
+        std::this_thread::yield();
+
+    counting.store(false);
+
+    return allocations.load();
+}
+
+static const int SPAWNED_TASKS = 10000;
+
+/**
+ * @brief Let both workers spawn SPAWNED_TASKS tasks each. The spawners wait for 
+ * each other, so every worker runs one of them, and no spawned task runs before 
+ * all are spawned. Every round therefore needs the same number of task slots.
+ */
+static void spawnOnBothWorkers(Threadpool &pool, std::atomic<int> &handled)
+{
+    std::atomic<int> started{0};
+    std::atomic<int> *startedPtr = &started;
+    std::atomic<int> *handledPtr = &handled;
+    Threadpool *poolPtr = &pool;
+
+    handled.store(0);
+
+    for (int spawner = 0; spawner < 2; spawner++)
+    {
+        pool.addTask([poolPtr, startedPtr, handledPtr]() {
+            startedPtr->fetch_add(1);
+
+            while (startedPtr->load() < 2)
+                std::this_thread::yield();
+
+            for (int i = 0; i < SPAWNED_TASKS; i++)
+            {
+                poolPtr->addTask([handledPtr]() {
+                    handledPtr->fetch_add(1, std::memory_order_relaxed);
+                });
+            }
+
+            startedPtr->fetch_add(1);
+
+            while (startedPtr->load() < 4)
+                std::this_thread::yield();
+
+            // Counted last, so started is no longer used when the round ends
+            handledPtr->fetch_add(1);
+        });
+    }
+
+    while (handled.load() < 2 * SPAWNED_TASKS + 2)
+        std::this_thread::yield();
+
+    // Let the workers give back the slots of the last tasks
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+}
+
+/**
+ * @return The number of allocations while the workers spawned and ran tasks, 
+ * after a first round created their task slots.
+ */
+static uint64_t countSpawnAllocations()
+{
+    Threadpool pool(2, QUEUED_CONNECTIONS, Threadpool::Scheduling::WorkStealing);
+
+    std::atomic<int> handled{0};
+
+    spawnOnBothWorkers(pool, handled);
+
+    allocations.store(0);
+    counting.store(true);
+
+    spawnOnBothWorkers(pool, handled);
+
+    counting.store(false);
+
+    return allocations.load();
+}
+
+int main()
+{
+    int failed = 0;
+
+    for (auto scheduling : {Threadpool::Scheduling::Fifo, Threadpool::Scheduling::WorkStealing})
+    {
+        const char *name = scheduling == Threadpool::Scheduling::Fifo ? "fifo" : "work stealing";
+
+        uint64_t count = countAllocations(scheduling);
+
+        std::printf("%s: %llu allocations for %d tasks\n", name, (unsigned long long)count, CONNECTIONS);
+
+        if (count != 0) failed = 1;
+    }
+
+    uint64_t count = countSpawnAllocations();
+
+    std::printf("spawned: %llu allocations for %d tasks\n", (unsigned long long)count, 2 * SPAWNED_TASKS);
+
+    if (count != 0) failed = 1;
+
+    return failed;
+}